@@ -7,7 +7,21 @@
 #include <SDL2/SDL_mixer.h>
 #include <SDL2/SDL_ttf.h>
 
+#include <assets.cpp>
 #include <board.cpp>
+#include <archive.cpp>
+#include <analysis.cpp>
+#include <computer.cpp>
+#include <review.cpp>
+#include <mate.cpp>
+#include <explorer.cpp>
+#include <session.cpp>
+#include <simul.cpp>
+#include <clock.cpp>
+#include <audio.cpp>
+#include <profiler.cpp>
+#include <metrics.cpp>
+#include <encoder.cpp>
 #include <constants.h>
 
 using namespace std;
@@ -15,6 +29,7 @@ using namespace std;
 //Globals
 SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
+SDL_Surface* frame_surface = NULL; // Drawn into by the off screen renderer when games are exported, instead of a window
 TTF_Font* font = NULL;
 Board chess_board(SIZE, FONT_SIZE / 2, FONT_SIZE / 2);
 bool app_is_running = true;
@@ -24,32 +39,77 @@ int last_frame_time = 0;
 int frame = 0;
 SDL_Rect moves_rect;
 int max_scroll, scroll_value;
-int start_time, black_time, white_time;
+TimeControl time_control = { (int64_t)TIME * 1000, 0, 0, 0 };
+ChessClock chess_clock(time_control);
+SDL_Texture* scene = NULL;
+bool scene_dirty = true;
+int scene_key[7];
+int audio_buffer = AUDIO_BUFFER;
+string archive_path = ARCHIVE_PATH;
+Audio audio;
+Analysis analysis;
+vector<SearchLine> analysis_lines;
+int analysis_version = 0;
+uint64_t analysis_key = 0;
+Color analysis_turn = WHITE;
+GameReview review;
+vector<MoveReview> review_moves; // Marks of the reviewed moves, in the order of the move panel
+int review_version = 0;
+MateFinder mate_finder;
+MateAnswer mate_answer = { MATE_UNKNOWN, 0, {}, 0, 0 };
+Position mate_position; // Position the mate is searched in
+bool mate_searching = false;
+int mate_version = 0;
+OpeningExplorer explorer;
+string explorer_path = EXPLORER_PATH;
+bool explorer_visible = false;
+vector<ExplorerEntry> explorer_moves; // Moves played in the shown position, the most played first
+Position explorer_position; // Shown position, to name the moves
+uint64_t explorer_key = 0;
+InputRecorder input_recorder;
+SimulView simul;
+int simul_boards = 0; // Games shown at once by the simul view, 0 for the single board
+SessionReplay session_replay;
+ComputerPlayer computer;
+bool computer_enabled = false;
+Color computer_side = BLACK;
+bool ponder_enabled = false;
+uint64_t computer_key = 0; // Position the computer was last asked to move in
+bool metrics_overlay = false;
+string metrics_path; // Prometheus text file, written every METRICS_INTERVAL_MS if set
+MetricsServer metrics_server;
+Uint32 last_metrics_update = 0;
+vector<uint64_t> last_metrics(METRIC_COUNT, 0);
+vector<string> metrics_lines;
 
-struct Sounds {
-    Mix_Music* game_start;
-    Mix_Music* game_end;
-    Mix_Music* move;
-    Mix_Music* move_check;
-    Mix_Music* capture;
-    Mix_Music* promote;
-} sounds;
+// Appends the current game to the game archive
+void save_game() {
+    ArchiveGame game = { "", result_from_state(chess_board.state), chess_board.getPackedMoves() };
+    ArchiveWriter writer;
+    if (!writer.open(archive_path) || !writer.write_game(game)) { return; }
+    writer.close();
+    cout << "Saved game with " << game.moves.size() << " moves to " << archive_path << endl;
+}
 
 // Initialize all music and sound
 bool initializeMixer() {
-    if (Mix_Init(0) != 0) {
-        cout << stderr << "Error initializing SLD_Mixer\n";
-        return false;
-    }
-    Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 1024);
-    sounds.game_start = Mix_LoadMUS(((string)SRC_PATH + "assets/sounds/game-start.mp3").c_str());
-    sounds.game_end = Mix_LoadMUS(((string)SRC_PATH + "assets/sounds/game-end.mp3").c_str());
-    sounds.move = Mix_LoadMUS(((string)SRC_PATH + "assets/sounds/move.mp3").c_str());
-    sounds.move_check = Mix_LoadMUS(((string)SRC_PATH + "assets/sounds/move-check.mp3").c_str());
-    sounds.capture = Mix_LoadMUS(((string)SRC_PATH + "assets/sounds/capture.mp3").c_str());
-    sounds.promote = Mix_LoadMUS(((string)SRC_PATH + "assets/sounds/promote.mp3").c_str());
+    return audio.init(audio_buffer, AUDIO_CHANNELS);
+}
 
-    return true;
+// Size of the window, and of the exported frames
+void layout_size(int* w, int* h) {
+    *h = SIZE + 2 * chess_board.getEntity().y;
+    *w = *h * 16 / 9;
+}
+
+// Size of what is drawn into, the window or the off screen frame
+void view_size(int* w, int* h) {
+    if (window != NULL) {
+        SDL_GetWindowSize(window, w, h);
+        return;
+    }
+    if (w != NULL) { *w = frame_surface->w; }
+    if (h != NULL) { *h = frame_surface->h; }
 }
 
 // Initialize SDL Window, renderer and TTF
@@ -58,9 +118,11 @@ bool initializeWindow() {
         cout <<  stderr << "Error initializing SDL.\n";
         return false;
     }
+    assets().open();
+    assets().preload_images("assets/textures/");
 
-    int h = SIZE + 2 * chess_board.getEntity().y;
-    int w = h * 16 / 9;
+    int w, h;
+    layout_size(&w, &h);
     window = SDL_CreateWindow(
         "Chess",
         SDL_WINDOWPOS_CENTERED,
@@ -74,10 +136,13 @@ bool initializeWindow() {
         cout << stderr << "Error creating SDL Window.\n";
         return false;
     }
-    SDL_Surface* surface = IMG_Load(((string)SRC_PATH + "icon.png").c_str());
+    SDL_Surface* surface = assets().load_image((string)SRC_PATH + "icon.png");
     SDL_SetWindowIcon(window, surface);
 
-    renderer = SDL_CreateRenderer(window, -1, 0);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE);
+    if (!renderer) { // Fall back to the software renderer, which also supports render targets
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE);
+    }
     if (!renderer) {
         cout << stderr << "Error creating SDL Renderer\n";
         return false;
@@ -92,7 +157,7 @@ bool initializeWindow() {
         return false;
     }
 
-    font = TTF_OpenFont(((string)SRC_PATH + "assets/fonts/UbuntuMono-B.ttf").c_str(), FONT_SIZE);
+    font = TTF_OpenFontRW(assets().open_rw((string)SRC_PATH + "assets/fonts/UbuntuMono-B.ttf"), 1, FONT_SIZE);
     if (!font) {
         cout << "Cannot find font file!\n";
         SDL_Quit();
@@ -101,15 +166,33 @@ bool initializeWindow() {
     return true;
 }
 
+// Milliseconds of the SDL timer, or of the virtual clock while a session is replayed
+Uint32 ticks_ms() {
+    return session_replay.is_open() ? (Uint32)(clock_now_us() / 1000) : SDL_GetTicks();
+}
+
+// Converts an SDL event timestamp (milliseconds) to the time of the clock
+int64_t event_time_us(Uint32 timestamp) {
+    if (session_replay.is_open()) { return clock_now_us(); } // Replayed events happen at the time of their frame
+    int64_t age = (Uint32)(SDL_GetTicks() - timestamp);
+    return clock_now_us() - age * 1000;
+}
+
 // Process input events using SDL_Event
 void process_input() {
+    PROFILE_SCOPE("process_input");
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
+        if (input_recorder.is_open()) { input_recorder.record(event, event_time_us(event.common.timestamp)); }
         switch (event.type)
         {
         case SDL_QUIT:
             app_is_running = false;
             break;
+        case SDL_RENDER_TARGETS_RESET: // The content of the cached layers was lost
+            chess_board.invalidate();
+            scene_dirty = true;
+            break;
         case SDL_KEYDOWN:
             switch (event.key.keysym.sym) {
             case SDLK_ESCAPE:
@@ -118,33 +201,74 @@ void process_input() {
             case SDLK_r: // Resets the board
                 chess_board.reset();
                 game_over = false;
-                Mix_PlayMusic(sounds.game_start, 1);
+                audio.play("game-start");
                 timer = false;
-                black_time = 0, white_time = 0;
+                chess_clock.reset(time_control);
+                computer.cancel();
+                computer_key = 0;
+                review.cancel();
+                mate_finder.stop();
                 break;
             case SDLK_t: // Starts the timer function
                 if (!timer && !game_over) { 
-                    start_time = SDL_GetTicks();
+                    chess_clock.start(chess_board.getTurn(), clock_now_us());
                     timer = true; 
                 }
             case SDLK_RIGHT:
                 if (chess_board.getCurrentMove() < chess_board.getMoves().size()) {
-                    Mix_PlayMusic(sounds.move, 1);
+                    audio.play("move");
                 }
                 chess_board.fast_forward();
                 break;
             case SDLK_LEFT:
                 if (chess_board.getCurrentMove() > 0) {
-                    Mix_PlayMusic(sounds.move, 1);
+                    audio.play("move");
                 }
                 chess_board.rewind();
                 break;
+            case SDLK_a: // Toggles the analysis of the shown position
+                if (analysis.is_running()) { analysis.stop(); }
+                else {
+                    analysis_key = 0;
+                    analysis.start();
+                }
+                break;
+            case SDLK_v: // Reviews every move of the game, the move panel marks the mistakes as they are found
+                review.start(chess_board.getPackedMoves());
+                break;
+            case SDLK_f: // Looks for the shortest forced mate of the side to move
+                mate_position = chess_board.getPosition();
+                mate_finder.start(mate_position, MATE_FIND_MOVES, MATE_FIND_MS);
+                break;
+            case SDLK_e: // Toggles the opening explorer below the move panel
+                if (!explorer.is_open()) {
+                    cout << "No opening index at " << explorer_path << ", build one with chess-explorer" << endl;
+                    break;
+                }
+                explorer_visible = !explorer_visible;
+                explorer_key = 0;
+                scene_dirty = true;
+                break;
+            case SDLK_s: // Saves the game to the archive
+                save_game();
+                break;
+            case SDLK_p: // Toggles the profiler overlay
+                profiler.overlay = !profiler.overlay;
+                break;
+            case SDLK_m: // Toggles the metrics overlay
+                metrics_overlay = !metrics_overlay;
+                break;
             default:
                 break;
             }
         case SDL_MOUSEBUTTONDOWN:
-            if (event.button.clicks = 1 && !game_over) { 
+            if (event.button.clicks = 1 && !game_over && !simul.is_open()) { 
+                Color turn = chess_board.getTurn();
+                if (computer_enabled && turn == computer_side && !chess_board.is_pawn_swapping()) { break; }
                 chess_board.check_mouse_hit(event.button.x, event.button.y);
+                if (timer && chess_board.getTurn() != turn) { // The move is timed from the click, not from this frame
+                    chess_clock.press(event_time_us(event.button.timestamp));
+                }
             }
             break;
         case SDL_MOUSEWHEEL: 
@@ -164,34 +288,27 @@ void process_input() {
 
 // Pause the frame too keep a steady FPS
 void sleep_frame() {
+    ScopedTimer timer("sleep_frame", true);
     int frame_target_time = 1000 / FPS;
-    int time_to_wait = frame_target_time - (SDL_GetTicks() - last_frame_time);
+    int time_to_wait = frame_target_time - (ticks_ms() - last_frame_time);
 
-    if (time_to_wait > 0 && time_to_wait <= frame_target_time) {
+    if (time_to_wait > 0 && time_to_wait <= frame_target_time && !session_replay.is_open()) { // A replay runs flat out
         SDL_Delay(time_to_wait);
     }
 
-    last_frame_time = SDL_GetTicks();
+    last_frame_time = ticks_ms();
 }
 
-// Updates the timer
+// Flags a player whose time ran out, and stops the clock when the game is over
 void update_timer() {
-    if (timer && !game_over) {
-        if (chess_board.getTurn() == WHITE) {
-            white_time = SDL_GetTicks() - start_time - black_time;
-        }
-        else if (chess_board.getTurn() == BLACK) {
-            black_time = SDL_GetTicks() - start_time - white_time;
-        }
-    }
-    if (black_time >= TIME && !game_over) { 
-        chess_board.state = BLACK_TIMES_UP; 
-        Mix_PlayMusic(sounds.game_end, 1);
-        game_over = true;
+    int64_t now = clock_now_us();
+    if (game_over) {
+        chess_clock.stop(now);
+        return;
     }
-    else if (white_time >= TIME && !game_over) { 
-        chess_board.state = WHITE_TIMES_UP; 
-        Mix_PlayMusic(sounds.game_end, 1);
+    if (timer && chess_clock.flag(now)) { 
+        chess_board.state = chess_clock.getRunningSide() == WHITE ? WHITE_TIMES_UP : BLACK_TIMES_UP; 
+        audio.play("game-end");
         game_over = true;
     }
 }
@@ -203,31 +320,130 @@ void update_sound() {
         Move move = chess_board.getMoves().at(chess_board.getMoves().size() - 1);
         if (state == NEUTRAL) {
             if (move.pawn_swapped == true && chess_board.is_pawn_swapping() == false) {
-                Mix_PlayMusic(sounds.promote, 1);
+                audio.play("promote");
             }
             else if (move.piece_captured) {
-                Mix_PlayMusic(sounds.capture, 1);
+                audio.play("capture");
             }
             else {
-                Mix_PlayMusic(sounds.move, 1);
+                audio.play("move");
             }
         }
         else if (state == WHITE_CHECK || state == BLACK_CHECK) {
-            Mix_PlayMusic(sounds.move_check, 1);
+            audio.play("move-check");
         }
         else if (state == WHITE_CHECKMATE || state == BLACK_CHECKMATE || state == TIE) {
-            Mix_PlayMusic(sounds.game_end, 1);
+            audio.play("game-end");
             game_over = true;
         }
         chess_board.board_updated = false;
     }
 }
 
+// Passes the shown position to the analysis, and takes over its newest lines once per frame
+void update_analysis() {
+    if (analysis.is_running() && !chess_board.is_pawn_swapping()) {
+        uint64_t key = chess_board.getPositionKey();
+        if (key != analysis_key) {
+            Position position = chess_board.getPosition();
+            analysis.set_position(position);
+            analysis_key = key;
+            analysis_turn = position.turn;
+        }
+    }
+    analysis.poll(analysis_lines, analysis_version);
+}
+
+// Takes the moves the review has marked since the last frame
+void update_review() {
+    review.poll(review_moves, review_version);
+}
+
+// Takes the answer of the mate search once it is found
+void update_mate() {
+    mate_finder.poll(mate_answer, mate_searching, mate_version);
+}
+
+// Looks up the moves of the shown position in the opening index when the position changes
+void update_explorer() {
+    if (!explorer_visible || chess_board.is_pawn_swapping()) { return; }
+    uint64_t key = chess_board.getPositionKey();
+    if (key == explorer_key) { return; }
+    uint32_t count;
+    const ExplorerEntry* found = explorer.find(key, count);
+    explorer_moves.assign(found, found + count);
+    sort(explorer_moves.begin(), explorer_moves.end(), [](const ExplorerEntry& a, const ExplorerEntry& b) {
+        return explorer_games(a) > explorer_games(b);
+    });
+    explorer_position = chess_board.getPosition();
+    explorer_key = key;
+}
+
+// Asks the computer for a move when it is its turn, plays it once found and then lets it ponder
+void update_computer() {
+    if (!computer_enabled || game_over || chess_board.is_pawn_swapping()) { return; }
+    if (chess_board.getCurrentMove() != chess_board.getMoves().size() || chess_board.getTurn() != computer_side) { return; }
+    uint64_t key = chess_board.getPositionKey();
+    if (key != computer_key) {
+        int64_t now = clock_now_us();
+        int time_ms = timer ? chess_clock.allocate(computer_side, now).optimum_us / 1000 : COMPUTER_MOVE_MS;
+        computer.think(chess_board.getPosition(), max(1, time_ms));
+        computer_key = key;
+    }
+    PackedMove move;
+    if (computer.poll(move) && chess_board.play_move(move)) {
+        if (timer) { chess_clock.press(clock_now_us()); }
+        if (ponder_enabled) { computer.ponder(chess_board.getPosition()); }
+    }
+}
+
+// Plays the moves of the simul's games that are due
+void update_simul() {
+    if (simul.is_open()) { simul.update(ticks_ms()); }
+}
+
+// Counts the frame, and once per interval writes the metrics file and updates the lines of the metrics view
+// with the rates since the last update
+void update_metrics() {
+    count_metric(METRIC_FRAMES);
+    Uint32 now = ticks_ms();
+    if (now - last_metrics_update < METRICS_INTERVAL_MS) { return; }
+    double seconds = (now - last_metrics_update) / 1000.0;
+    last_metrics_update = now;
+    if (!metrics_path.empty()) { Metrics::instance().write_file(metrics_path); }
+
+    vector<uint64_t> totals = Metrics::instance().snapshot();
+    char line[128];
+    metrics_lines.clear();
+    metrics_lines.push_back("metric                              total      per s");
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        snprintf(line, sizeof(line), "%-26s %15llu %10.0f", metric_names[i][0] + 6, (unsigned long long)totals[i],
+            (totals[i] - last_metrics[i]) / seconds);
+        metrics_lines.push_back(line);
+    }
+    uint64_t lookups = totals[METRIC_LEGAL_CACHE_HITS] + totals[METRIC_LEGAL_CACHE_MISSES];
+    snprintf(line, sizeof(line), "%-26s %14.1f%%", "legal cache hit rate",
+        lookups ? 100.0 * totals[METRIC_LEGAL_CACHE_HITS] / lookups : 0.0);
+    metrics_lines.push_back(line);
+    snprintf(line, sizeof(line), "%-26s %14.1f%%", "tt hit rate",
+        totals[METRIC_TT_PROBES] ? 100.0 * totals[METRIC_TT_HITS] / totals[METRIC_TT_PROBES] : 0.0);
+    metrics_lines.push_back(line);
+    last_metrics = totals;
+}
+
 // General update function
 void update() {
     sleep_frame();
+    PROFILE_SCOPE("update");
     update_timer();
     update_sound();
+    update_analysis();
+    update_review();
+    update_mate();
+    update_explorer();
+    update_computer();
+    update_simul();
+    update_metrics();
 }
 
 // Function to render text from a char* if the last param is true, then center text on the x,y coordinates.
@@ -243,10 +459,11 @@ void render_text(char* text, SDL_Color color, int x, int y, bool centered) {
 
 // Render the "past moves" display
 void render_moves_display() {
+    PROFILE_SCOPE("render_moves_display");
     Entity board = chess_board.getEntity();
     int x, w;
     x = board.x + board.w + FONT_SIZE / 2;
-    SDL_GetWindowSize(window, &w, NULL);
+    view_size(&w, NULL);
     w = (w - x) - FONT_SIZE / 2;
     moves_rect = { x, board.y + board.h / 4, w, board.h / 2 };
     SDL_Rect moves_barrier_rect = { x, 0, w, moves_rect.h / 2 + FONT_SIZE / 2 };
@@ -279,6 +496,15 @@ void render_moves_display() {
             string text ="  ->" + moves.at(i).to;
             render_text(&text[0], white, x, y, false);
 
+            if (i < review_moves.size() && review_moves[i].mark >= MARK_INACCURACY) { // Review mark in the corner
+                static const char* symbols[] = { "", "", "?!", "?", "??" };
+                static const SDL_Color colors[] = { {}, {}, { 230, 200, 80, 255 }, { 240, 140, 50, 255 }, { 230, 60, 60, 255 } };
+                MoveMark mark = review_moves[i].mark;
+                TTF_SetFontSize(font, FONT_SIZE / 3);
+                render_text((char*)symbols[mark], colors[mark], x + moves_rect.w / 4 - FONT_SIZE / 3, y, false);
+                TTF_SetFontSize(font, FONT_SIZE);
+            }
+
             if (i == moves.size() - 1 && ent.y + scroll_value + ent.h > moves_rect.y + moves_rect.h) {
                 max_scroll = (ent.y + scroll_value + ent.h) - (moves_rect.y + moves_rect.h);
             }
@@ -292,8 +518,10 @@ void render_moves_display() {
 
 // Renders the timers in minutes and seconds
 void render_timer() {
-    int white_time_left = TIME - white_time; 
-    int black_time_left = TIME - black_time;
+    PROFILE_SCOPE("render_timer");
+    int64_t now = clock_now_us();
+    int white_time_left = chess_clock.time_left(WHITE, now) / 1000; 
+    int black_time_left = chess_clock.time_left(BLACK, now) / 1000;
     int minutes, seconds;
 
     int x, y, w, h;
@@ -324,8 +552,109 @@ void render_timer() {
     render_text(&white_time_string[0], black, x + timer_rect.w / 2, y, true);
 }
 
+// Score in pawns from white's view, or the moves until mate
+string score_text(int score, Color turn) {
+    if (turn == BLACK) { score = -score; }
+    char text[16];
+    if (abs(score) >= MATE_BOUND) {
+        int moves = (MATE_SCORE - abs(score) + 1) / 2;
+        snprintf(text, sizeof(text), "#%s%d", score < 0 ? "-" : "", moves);
+    }
+    else { snprintf(text, sizeof(text), "%+.2f", score / 100.0); }
+    return text;
+}
+
+// Render the analysis lines below the white timer
+void render_analysis() {
+    if (!analysis.is_running()) { return; }
+    PROFILE_SCOPE("render_analysis");
+    int line_height = FONT_SIZE / 3;
+    int w, h;
+    view_size(&w, &h);
+    int y = moves_rect.y + moves_rect.h + moves_rect.h / 3 + FONT_SIZE / 4;
+    SDL_Rect analysis_rect = { moves_rect.x, y, moves_rect.w, h - y - FONT_SIZE / 4 };
+    SDL_SetRenderDrawColor(renderer, 60, 50, 40, 255);
+    SDL_RenderFillRect(renderer, &analysis_rect);
+    TTF_SetFontSize(font, line_height);
+    SDL_Color white = { 255, 255, 255, 255 };
+    int max_moves = analysis_rect.w / (3 * line_height) - 3; // Moves that fit next to the depth and score
+    string text = "Analysis";
+    if (!analysis_lines.empty() && analysis_lines[0].time_ms > 0) {
+        text += "   " + to_string(analysis_lines[0].nodes * 1000 / analysis_lines[0].time_ms / 1000) + " knps";
+    }
+    render_text(&text[0], white, analysis_rect.x + line_height / 4, y, false);
+    for (auto& line : analysis_lines) {
+        if (line.pv.empty()) { continue; }
+        y += line_height;
+        if (y + line_height > analysis_rect.y + analysis_rect.h) { break; }
+        text = to_string(line.depth) + "  " + score_text(line.score, analysis_turn) + " ";
+        for (int i = 0; i < (int)line.pv.size() && i < max_moves; i++) { text += " " + move_name(line.pv[i]); }
+        render_text(&text[0], white, analysis_rect.x + line_height / 4, y, false);
+    }
+    TTF_SetFontSize(font, FONT_SIZE);
+}
+
+// Render the moves of the opening explorer below the move panel, where the analysis goes while it runs
+void render_explorer() {
+    if (!explorer_visible || analysis.is_running()) { return; }
+    PROFILE_SCOPE("render_explorer");
+    int line_height = FONT_SIZE / 3;
+    int w, h;
+    view_size(&w, &h);
+    int y = moves_rect.y + moves_rect.h + moves_rect.h / 3 + FONT_SIZE / 4;
+    SDL_Rect explorer_rect = { moves_rect.x, y, moves_rect.w, h - y - FONT_SIZE / 4 };
+    SDL_SetRenderDrawColor(renderer, 60, 50, 40, 255);
+    SDL_RenderFillRect(renderer, &explorer_rect);
+    TTF_SetFontSize(font, line_height);
+    SDL_Color white = { 255, 255, 255, 255 };
+    uint32_t total = 0;
+    for (auto& entry : explorer_moves) { total += explorer_games(entry); }
+    string text = explorer_moves.empty() ? "Explorer   no games" : "Explorer   " + to_string(total) + " games";
+    render_text(&text[0], white, explorer_rect.x + line_height / 4, y, false);
+    for (auto& entry : explorer_moves) {
+        y += line_height;
+        if (y + line_height > explorer_rect.y + explorer_rect.h) { break; }
+        uint32_t games = explorer_games(entry);
+        char line[64];
+        snprintf(line, sizeof(line), "%-8s%7u  %3u%% %3u%% %3u%%", explorer_position.san(entry.move).c_str(), games,
+            100 * entry.white_wins / games, 100 * entry.draws / games, 100 * entry.black_wins / games);
+        render_text(line, white, explorer_rect.x + line_height / 4, y, false);
+    }
+    TTF_SetFontSize(font, FONT_SIZE);
+}
+
+// Render the answer of the mate search above the black timer
+void render_mate() {
+    string text;
+    if (mate_searching) { text = "Looking for a mate..."; }
+    else if (mate_answer.result == MATE_FOUND) {
+        text = "Mate in " + to_string(mate_answer.moves) + ":";
+        Position position = mate_position;
+        for (PackedMove move : mate_answer.line) {
+            text += " " + position.san(move);
+            Undo undo;
+            position.do_move(move, undo);
+        }
+    }
+    else if (mate_answer.result == MATE_NONE) { text = "No mate in " + to_string(mate_answer.moves); }
+    else if (mate_answer.moves > 0) { text = "No mate found up to mate in " + to_string(mate_answer.moves - 1); }
+    if (text.empty()) { return; }
+    PROFILE_SCOPE("render_mate");
+    int line_height = FONT_SIZE / 3;
+    size_t max_length = moves_rect.w / (line_height / 2) - 1; // The font is monospaced, half as wide as high
+    if (text.length() > max_length) { text = text.substr(0, max_length - 3) + "..."; }
+    SDL_Rect mate_rect = { moves_rect.x, FONT_SIZE / 4, moves_rect.w, line_height + line_height / 2 };
+    SDL_SetRenderDrawColor(renderer, 60, 50, 40, 255);
+    SDL_RenderFillRect(renderer, &mate_rect);
+    TTF_SetFontSize(font, line_height);
+    SDL_Color white = { 255, 255, 255, 255 };
+    render_text(&text[0], white, mate_rect.x + line_height / 4, mate_rect.y + line_height / 4, false);
+    TTF_SetFontSize(font, FONT_SIZE);
+}
+
 // Render states like "check" and "checkmate"
 void render_states() {
+    PROFILE_SCOPE("render_states");
     TTF_SetFontSize(font, FONT_SIZE / 2);
     Entity ent = chess_board.getEntity();
     SDL_Rect state_rect { ent.x, 0, ent.w, FONT_SIZE / 2 };
@@ -397,6 +726,7 @@ void render_states() {
 
 // Render the movement animation for when a piece is moved
 void render_move_animation() {
+    PROFILE_SCOPE("render_move_animation");
     if (chess_board.animation != NULL) {
         Entity* last_move = chess_board.getLastMove();
         if (frame <= 30) { // Based on a 30 frame animation. Can be configured.
@@ -406,52 +736,333 @@ void render_move_animation() {
             chess_board.animation->getEntity().render(renderer);
             frame++;
         }
-        else {
+        if (frame > 30) { // Ended on the frame that shows the piece on its field, the next scene draws it there
             chess_board.animation = NULL;
             frame = 0;
         }
     }
 }
 
-// General render function
-void render() {
+// Render the profiler overlay with frame time percentiles
+void render_profiler() {
+    if (!profiler.overlay) { return; }
+    PROFILE_SCOPE("render_profiler");
+    vector<string> lines = profiler.getOverlayLines();
+    int line_height = FONT_SIZE / 3;
+    TTF_SetFontSize(font, line_height);
+    SDL_Rect overlay_rect = { 0, 0, 28 * line_height, (int)lines.size() * line_height + line_height / 2 };
+    SDL_SetRenderDrawColor(renderer, 20, 20, 20, 255);
+    SDL_RenderFillRect(renderer, &overlay_rect);
+    SDL_Color white = { 255, 255, 255, 255 };
+    for (int i = 0; i < lines.size(); i++) {
+        render_text(&lines[i][0], white, line_height / 4, line_height / 4 + i * line_height, false);
+    }
+    TTF_SetFontSize(font, FONT_SIZE);
+}
+
+// Render the metrics overlay in the top right corner
+void render_metrics() {
+    if (!metrics_overlay) { return; }
+    PROFILE_SCOPE("render_metrics");
+    int line_height = FONT_SIZE / 3;
+    int w;
+    view_size(&w, NULL);
+    TTF_SetFontSize(font, line_height);
+    SDL_Rect overlay_rect = { w - 28 * line_height, 0, 28 * line_height, (int)metrics_lines.size() * line_height + line_height / 2 };
+    SDL_SetRenderDrawColor(renderer, 20, 20, 20, 255);
+    SDL_RenderFillRect(renderer, &overlay_rect);
+    SDL_Color white = { 255, 255, 255, 255 };
+    for (int i = 0; i < metrics_lines.size(); i++) {
+        render_text(&metrics_lines[i][0], white, overlay_rect.x + line_height / 4, line_height / 4 + i * line_height, false);
+    }
+    TTF_SetFontSize(font, FONT_SIZE);
+}
+
+// Checks if anything shown in the cached scene has changed since it was drawn
+bool scene_changed() {
+    int64_t now = clock_now_us();
+    int key[7] = { scroll_value, chess_board.state, (int)(chess_clock.time_left(WHITE, now) / 1000000),
+        (int)(chess_clock.time_left(BLACK, now) / 1000000), analysis_version, review_version, mate_version };
+    bool changed = scene_dirty || chess_board.needs_render() || memcmp(key, scene_key, sizeof(key)) != 0;
+    memcpy(scene_key, key, sizeof(key));
+    return changed;
+}
+
+// Draws the background, the panels and the board into the scene texture
+void render_scene() {
+    PROFILE_SCOPE("render_scene");
+    if (scene == NULL) {
+        int w, h;
+        view_size(&w, &h);
+        scene = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    }
+    SDL_SetRenderTarget(renderer, scene);
     SDL_SetRenderDrawColor(renderer, 70, 60, 50, 255);
     SDL_RenderClear(renderer);
 
     render_moves_display();
 
-    chess_board.render(renderer);
+    {
+        PROFILE_SCOPE("Board::render");
+        chess_board.render(renderer);
+    }
 
     render_states();
 
     render_timer();
 
-    render_move_animation();
+    render_analysis();
+
+    render_explorer();
+
+    render_mate();
+
+    SDL_SetRenderTarget(renderer, NULL);
+    scene_dirty = false;
+}
+
+// General render function, a steady frame is a single copy of the cached scene
+void render() {
+    PROFILE_SCOPE("render");
+    if (simul.is_open()) { // The boards of the simul replace the scene, they change every few frames anyway
+        PROFILE_SCOPE("render_simul");
+        int w, h;
+        view_size(&w, &h);
+        SDL_SetRenderDrawColor(renderer, 70, 60, 50, 255);
+        SDL_RenderClear(renderer);
+        simul.render(renderer, w, h);
+    }
+    else {
+        if (scene_changed()) { render_scene(); }
+        SDL_RenderCopy(renderer, scene, NULL, NULL);
+
+        render_move_animation();
+    }
+
+    render_profiler();
+
+    render_metrics();
     
+    PROFILE_SCOPE("present");
     SDL_RenderPresent(renderer);
 }
 
+// Renders games of the archive off screen with the software renderer, without a window or a display, and writes
+// every frame of their replay. Nothing waits for the frame time, the frames are rendered as fast as the CPU
+// allows while the encoder threads write the earlier ones. Every game gets a folder of numbered PNG frames,
+// or with raw a stream of RGB pixels, which for "-" goes to the standard output.
+int export_games(string archive, string output, uint32_t first, uint32_t count, bool raw, int threads) {
+    ostream& log = output == "-" ? cerr : cout; // The standard output may be the video
+    ArchiveReader reader;
+    if (!reader.open(archive) || !reader.seek(first)) {
+        log << "Cannot read game " << first << " of " << archive << endl;
+        return 1;
+    }
+    if (SDL_Init(0) != 0 || TTF_Init() != 0) {
+        log << "Error initializing SDL.\n";
+        return 1;
+    }
+    assets().open();
+    assets().preload_images("assets/textures/");
+    int w, h;
+    layout_size(&w, &h);
+    frame_surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    renderer = frame_surface != NULL ? SDL_CreateSoftwareRenderer(frame_surface) : NULL;
+    font = TTF_OpenFontRW(assets().open_rw((string)SRC_PATH + "assets/fonts/UbuntuMono-B.ttf"), 1, FONT_SIZE);
+    if (!renderer || !font) {
+        log << "Error creating the off screen renderer\n";
+        return 1;
+    }
+
+    error_code error;
+    if (raw && output != "-") { filesystem::create_directories(output, error); }
+    FrameEncoder encoder;
+    FramePixels pixels;
+    auto capture = [&]() {
+        render();
+        pixels = make_shared<vector<uint32_t>>(w * h);
+        SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ARGB8888, pixels->data(), w * 4);
+        encoder.submit(pixels);
+    };
+    auto hold = [&]() { // The position stays, so the last frame is written again without drawing it
+        for (int i = 0; i < EXPORT_HOLD_FRAMES; i++) { encoder.submit(pixels); }
+    };
+
+    auto start = chrono::steady_clock::now();
+    uint64_t frames = 0;
+    int exported = 0;
+    ArchiveGame game;
+    for (uint32_t number = first; number - first < count && reader.next(game); number++) {
+        if (!game.fen.empty()) {
+            log << "Game " << number << " doesn't start from the start position, skipped\n";
+            continue;
+        }
+        string name = output + "/game_" + to_string(number);
+        bool opened = raw ? encoder.open_stream(output == "-" ? output : name + ".rgb", w, h, threads)
+            : encoder.open_frames(name, w, h, threads);
+        if (!opened) { break; }
+        chess_board.reset();
+        frame = 0;
+        scroll_value = 0;
+        max_scroll = 0;
+        scene_dirty = true;
+        capture();
+        hold();
+        for (PackedMove move : game.moves) {
+            if (!chess_board.play_move(move)) {
+                log << "Game " << number << ": cannot play " << move_name(move) << endl;
+                break;
+            }
+            scroll_value = max_scroll; // Keeps the latest moves in view
+            do { capture(); } while (chess_board.animation != NULL);
+            hold();
+        }
+        if (!encoder.finish()) {
+            log << "Cannot write the frames of game " << number << endl;
+            break;
+        }
+        frames += encoder.getFrames();
+        exported++;
+        log << "Game " << number << ": " << game.moves.size() << " moves, " << encoder.getFrames() << " frames\n";
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    log << "Exported " << exported << " games, " << frames << " frames of " << w << "x" << h << " in " << seconds
+        << "s, " << (int)(frames / max(seconds, 0.001)) << " frames/s\n";
+    if (raw && exported > 0) { log << "Play with: ffmpeg -f rawvideo -pix_fmt rgb24 -s " << w << "x" << h << " -r " << FPS << " -i FILE\n"; }
+
+    SDL_DestroyTexture(scene);
+    Entity::releaseTextures(renderer);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(frame_surface);
+    TTF_CloseFont(font);
+    assets().release();
+    SDL_Quit();
+    return exported > 0 ? 0 : 1;
+}
+
 // Cleanup and prepare for close down
 void cleanup() {
+    SDL_DestroyTexture(scene);
+    simul.release();
+    Entity::releaseTextures(renderer);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     TTF_CloseFont(font);
+    analysis.stop();
+    computer.stop();
+    review.cancel();
+    mate_finder.stop();
+    metrics_server.stop();
+    input_recorder.close();
+    audio.cleanup();
+    assets().release();
     Mix_CloseAudio();
     SDL_Quit();
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    string export_archive, export_output;
+    uint32_t export_first = 0, export_count = 1;
+    bool export_raw = false;
+    int export_threads = thread::hardware_concurrency();
+    string record_path, replay_path, replay_csv;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--trace" && i + 1 < argc) { // Record a chrome trace of every frame
+            profiler.enable_trace(argv[++i]);
+        }
+        else if (arg == "--profile") { // Start with the profiler overlay visible
+            profiler.overlay = true;
+        }
+        else if (arg == "--audio-buffer" && i + 1 < argc) { // Audio buffer size in sample frames
+            audio_buffer = atoi(argv[++i]);
+        }
+        else if (arg == "--archive" && i + 1 < argc) { // Game archive used by the save key
+            archive_path = argv[++i];
+        }
+        else if (arg == "--time" && i + 1 < argc) { // Time control in seconds, [moves/]base[+increment][d delay]
+            if (!parse_time_control(argv[++i], time_control)) {
+                cout << "Invalid time control: " << argv[i] << endl;
+                return 1;
+            }
+            chess_clock.reset(time_control);
+        }
+        else if (arg == "--computer" && i + 1 < argc) { // Side played by the computer, white or black
+            string side = argv[++i];
+            computer_enabled = true;
+            computer_side = side == "white" ? WHITE : BLACK;
+        }
+        else if (arg == "--ponder") { // The computer keeps thinking on the expected reply during the human's turn
+            ponder_enabled = true;
+        }
+        else if (arg == "--metrics-file" && i + 1 < argc) { // Prometheus text file for a node exporter's text collector
+            metrics_path = argv[++i];
+        }
+        else if (arg == "--metrics-port" && i + 1 < argc) { // Serves the metrics on 127.0.0.1 for a Prometheus scraper
+            metrics_server.start(atoi(argv[++i]));
+        }
+        else if (arg == "--explorer" && i + 1 < argc) { // Opening index shown by the explorer key
+            explorer_path = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc) { // Records the input events of the session
+            record_path = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc) { // Replays a recorded session without a display, and reports its cost
+            replay_path = argv[++i];
+        }
+        else if (arg == "--replay-csv" && i + 1 < argc) { // Writes the cost of every replayed frame
+            replay_csv = argv[++i];
+        }
+        else if (arg == "--simul" && i + 1 < argc) { // Replays that many games of the archive at once, up to 64
+            simul_boards = atoi(argv[++i]);
+        }
+        else if (arg == "--export" && i + 2 < argc) { // Renders games of ARCHIVE into OUTPUT without a window
+            export_archive = argv[++i];
+            export_output = argv[++i];
+        }
+        else if (arg == "--export-games" && i + 2 < argc) { // First game and number of games to export
+            export_first = atoi(argv[++i]);
+            export_count = atoi(argv[++i]);
+        }
+        else if (arg == "--export-raw") { // Exports a raw RGB stream per game instead of PNG frames
+            export_raw = true;
+        }
+        else if (arg == "--export-threads" && i + 1 < argc) { // Threads encoding the exported frames
+            export_threads = atoi(argv[++i]);
+        }
+    }
+    if (!export_archive.empty()) {
+        return export_games(export_archive, export_output, export_first, export_count, export_raw, export_threads);
+    }
+    if (!replay_path.empty()) {
+        if (!session_replay.open(replay_path, replay_csv)) { return 1; }
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+    }
+    else if (!record_path.empty() && !input_recorder.open(record_path)) { return 1; }
+    if (computer_enabled) { computer.start(); }
+    explorer.open(explorer_path);
     
     initializeWindow();
+    if (simul_boards > 0) { simul.open(archive_path, simul_boards, ticks_ms()); }
     chess_board.reset();
-    Mix_PlayMusic(sounds.game_start, 1);
+    audio.play("game-start");
     
     while (app_is_running) {
+        profiler.begin_frame();
+        if (session_replay.is_open()) { session_replay.begin_frame(); }
         process_input();
         update();
         render();
+        if (session_replay.is_open()) {
+            session_replay.end_frame();
+            if (session_replay.finished()) { app_is_running = false; }
+        }
+        profiler.end_frame();
     }
+    session_replay.report(cout);
 
+    profiler.write_trace();
     cleanup();
 
     return 1;
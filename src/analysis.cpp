@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <search.cpp>
+
+using namespace std;
+
+#define ANALYSIS_HASH_MB 64
+#define ANALYSIS_MULTIPV 3
+
+// Analyses the given position on a background thread until a new position is set.
+// The transposition table is kept for the whole session, so going back and forth through a game
+// continues from the results of earlier searches.
+class Analysis {
+    private:
+        TranspositionTable tt;
+        Search search;
+        thread worker;
+        mutex lock;
+        condition_variable wake;
+        Position pending;
+        bool has_pending = false;
+        bool quit = false;
+        uint64_t position_key = 0;
+        int multipv = ANALYSIS_MULTIPV;
+        vector<SearchLine> lines;
+        int version = 0;
+
+        void loop() {
+            unique_lock<mutex> guard(lock);
+            while (true) {
+                wake.wait(guard, [this] { return has_pending || quit; });
+                if (quit) { return; }
+                Position position = pending;
+                has_pending = false;
+                search.stop = false;
+                guard.unlock();
+
+                SearchLimits limits = { 0, multipv, 0, 0, false };
+                search.run(position, limits, [this](const vector<SearchLine>& found) {
+                    lock_guard<mutex> publish(lock);
+                    if (has_pending) { return; } // Results of a position that is no longer shown
+                    lines = found;
+                    version++;
+                });
+                guard.lock();
+            }
+        }
+
+    public:
+        Analysis() : tt(ANALYSIS_HASH_MB), search(tt) {}
+        ~Analysis() { stop(); }
+
+        bool is_running() { return worker.joinable(); }
+
+        void start() {
+            if (is_running()) { return; }
+            quit = false;
+            position_key = 0;
+            worker = thread(&Analysis::loop, this);
+        }
+
+        void stop() {
+            if (!is_running()) { return; }
+            {
+                lock_guard<mutex> guard(lock);
+                quit = true;
+                search.stop = true;
+            }
+            wake.notify_one();
+            worker.join();
+            lines.clear();
+            version++;
+        }
+
+        // Starts analysing the position, unless it is the one already being analysed
+        void set_position(const Position& position) {
+            lock_guard<mutex> guard(lock);
+            if (position.key == position_key) { return; }
+            position_key = position.key;
+            pending = position;
+            has_pending = true;
+            search.stop = true;
+            lines.clear();
+            version++;
+            wake.notify_one();
+        }
+
+        // Copies the current lines if they changed since the given version, returns false otherwise
+        bool poll(vector<SearchLine>& out, int& seen_version) {
+            lock_guard<mutex> guard(lock);
+            if (seen_version == version) { return false; }
+            out = lines;
+            seen_version = version;
+            return true;
+        }
+};
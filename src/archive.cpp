@@ -0,0 +1,338 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+
+#include <position.cpp>
+
+using namespace std;
+
+// Binary game archive, storing every move as its index in the sorted list of pseudo legal moves (one byte per ply).
+//
+// Layout, all numbers little endian:
+//   header   "CHSA", version (u16), reserved (u16), games per block (u32)
+//   blocks   games written back to back, each game is:
+//              flags (u8): bit 0 custom start position, bits 1-2 result
+//              plies (varint)
+//              start position FEN, if bit 0 is set: length (u8) and characters
+//              one move index per ply
+//   index    per block: file offset (u64), first game (u32), length in bytes (u32)
+//   footer   index offset (u64), games (u32), blocks (u32), "CHSI"
+//
+// Blocks are read in one piece, so bulk replay streams through the file, and the index allows
+// jumping to any game by only reading the block it is in.
+
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BLOCK_GAMES 1024
+#define ARCHIVE_HEADER_SIZE 12
+#define ARCHIVE_FOOTER_SIZE 20
+
+enum GameResult { UNKNOWN_RESULT, WHITE_WINS, BLACK_WINS, DRAW };
+
+// Result of a game that ended in the given state
+inline GameResult result_from_state(State state) {
+    switch (state) {
+        case WHITE_CHECKMATE: case WHITE_TIMES_UP: return BLACK_WINS;
+        case BLACK_CHECKMATE: case BLACK_TIMES_UP: return WHITE_WINS;
+        case TIE: return DRAW;
+        default: return UNKNOWN_RESULT;
+    }
+}
+
+// A game as it is stored in an archive
+typedef struct {
+    string fen; // Empty for the standard start position
+    GameResult result;
+    vector<PackedMove> moves;
+} ArchiveGame;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t first_game;
+    uint32_t length;
+} ArchiveBlock;
+
+// Moves in the order used by the archive. These are the pseudo legal moves, so only the stored move has to be
+// checked for legality while replaying, and they are sorted so the index doesn't depend on the generator order.
+inline int archive_moves(Position& position, PackedMove* list) {
+    int count = position.generate_pseudo_moves(list);
+    sort(list, list + count);
+    return count;
+}
+
+inline void put_u32(string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) { out += char(value >> (8 * i)); }
+}
+inline void put_u64(string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) { out += char(value >> (8 * i)); }
+}
+inline uint32_t get_u32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+inline uint64_t get_u64(const uint8_t* in) {
+    return get_u32(in) | ((uint64_t)get_u32(in + 4) << 32);
+}
+
+// The block index of an archive, read from its footer
+typedef struct {
+    vector<ArchiveBlock> blocks;
+    uint32_t games;
+    uint64_t index_offset;
+} ArchiveIndex;
+
+inline bool read_archive_index(string path, ArchiveIndex& index) {
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) { return false; }
+    int64_t size = in.tellg();
+    if (size < ARCHIVE_HEADER_SIZE + ARCHIVE_FOOTER_SIZE) { return false; }
+    uint8_t header[ARCHIVE_HEADER_SIZE], footer[ARCHIVE_FOOTER_SIZE];
+    in.seekg(0);
+    in.read((char*)header, sizeof(header));
+    in.seekg(size - ARCHIVE_FOOTER_SIZE);
+    in.read((char*)footer, sizeof(footer));
+    if (!in || memcmp(header, "CHSA", 4) != 0 || memcmp(footer + 16, "CHSI", 4) != 0) { return false; }
+    if ((header[4] | (header[5] << 8)) > ARCHIVE_VERSION) { return false; }
+
+    index.index_offset = get_u64(footer);
+    index.games = get_u32(footer + 8);
+    uint32_t block_count = get_u32(footer + 12);
+    if (index.index_offset + block_count * 16ULL + ARCHIVE_FOOTER_SIZE != (uint64_t)size) { return false; }
+    vector<uint8_t> entries(block_count * 16);
+    in.seekg(index.index_offset);
+    in.read((char*)entries.data(), entries.size());
+    index.blocks.resize(block_count);
+    for (uint32_t i = 0; i < block_count; i++) {
+        index.blocks[i] = { get_u64(&entries[i * 16]), get_u32(&entries[i * 16 + 8]), get_u32(&entries[i * 16 + 12]) };
+    }
+    return (bool)in;
+}
+
+// Writes games to an archive, one block at a time
+class ArchiveWriter {
+    private:
+        fstream file;
+        string path;
+        string block;
+        vector<ArchiveBlock> blocks;
+        uint32_t games = 0;
+        uint32_t block_games = 0;
+        uint64_t offset = 0;
+
+        void flush_block() {
+            if (block.empty()) { return; }
+            blocks.push_back({ offset, games - block_games, (uint32_t)block.size() });
+            file.write(block.data(), block.size());
+            offset += block.size();
+            block.clear();
+            block_games = 0;
+        }
+
+    public:
+        ~ArchiveWriter() { close(); }
+
+        // Opens the archive for writing, new games are added after the existing ones if it already exists
+        bool open(string path) {
+            this->path = path;
+            blocks.clear();
+            games = 0;
+            block_games = 0;
+            if (filesystem::exists(path)) {
+                ArchiveIndex existing;
+                if (!read_archive_index(path, existing)) {
+                    cout << "Not a game archive: " << path << endl;
+                    return false;
+                }
+                blocks = existing.blocks;
+                games = existing.games;
+                offset = existing.index_offset;
+                file.open(path, ios::in | ios::out | ios::binary);
+                file.seekp(offset);
+            }
+            else {
+                file.open(path, ios::out | ios::binary);
+                string header = "CHSA";
+                header += char(ARCHIVE_VERSION & 255);
+                header += char(ARCHIVE_VERSION >> 8);
+                header += string(2, '\0');
+                put_u32(header, ARCHIVE_BLOCK_GAMES);
+                file.write(header.data(), header.size());
+                offset = ARCHIVE_HEADER_SIZE;
+            }
+            if (!file) {
+                cout << "Cannot write: " << path << endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Adds a game, the moves have to be legal from the start position. A game that isn't added leaves the
+        // block as it was.
+        bool write_game(const ArchiveGame& game) {
+            Position position;
+            if (!game.fen.empty() && (game.fen.size() > 255 || !position.load_fen(game.fen))) { return false; }
+
+            size_t mark = block.size();
+            block += char((game.fen.empty() ? 0 : 1) | (game.result << 1));
+            for (uint32_t plies = game.moves.size(); ; plies >>= 7) { // varint
+                block += char((plies & 127) | (plies >= 128 ? 128 : 0));
+                if (plies < 128) { break; }
+            }
+            if (!game.fen.empty()) {
+                block += char(game.fen.size());
+                block += game.fen;
+            }
+            PackedMove list[MAX_MOVES];
+            for (auto& move : game.moves) {
+                int count = archive_moves(position, list);
+                int index = lower_bound(list, list + count, move) - list;
+                if (index == count || list[index] != move || !position.is_legal(move)) {
+                    cout << "Illegal move in archived game: " << move_name(move) << endl;
+                    block.resize(mark);
+                    return false;
+                }
+                block += char(index);
+                Undo undo;
+                position.do_move(move, undo);
+            }
+            games++;
+            if (++block_games == ARCHIVE_BLOCK_GAMES) { flush_block(); }
+            return true;
+        }
+
+        // Writes the last block, the index and the footer
+        void close() {
+            if (!file.is_open()) { return; }
+            flush_block();
+            string index;
+            for (auto& b : blocks) {
+                put_u64(index, b.offset);
+                put_u32(index, b.first_game);
+                put_u32(index, b.length);
+            }
+            put_u64(index, offset);
+            put_u32(index, games);
+            put_u32(index, blocks.size());
+            index += "CHSI";
+            file.write(index.data(), index.size());
+            file.close();
+            filesystem::resize_file(path, offset + index.size()); // An appended index may be shorter than the old one
+        }
+};
+
+// Reads games from an archive, either one after the other or from any game number
+class ArchiveReader {
+    private:
+        ifstream file;
+        ArchiveIndex index;
+        vector<uint8_t> block;
+        size_t block_position = 0;
+        int current_block = -1;
+        uint32_t current_game = 0;
+
+        bool load_block(int number) {
+            if (number >= (int)index.blocks.size()) { return false; }
+            ArchiveBlock& b = index.blocks[number];
+            block.resize(b.length);
+            file.seekg(b.offset);
+            file.read((char*)block.data(), b.length);
+            block_position = 0;
+            current_block = number;
+            current_game = b.first_game;
+            return (bool)file;
+        }
+
+    public:
+        bool open(string path) {
+            if (!read_archive_index(path, index)) {
+                cout << "Not a game archive: " << path << endl;
+                return false;
+            }
+            file.open(path, ios::binary);
+            current_block = -1;
+            current_game = 0;
+            block.clear();
+            block_position = 0;
+            return (bool)file;
+        }
+
+        uint32_t game_count() { return index.games; }
+
+        // Moves to the given game number, only the block holding it is read
+        bool seek(uint32_t game) {
+            if (game >= index.games) { return false; }
+            auto it = upper_bound(index.blocks.begin(), index.blocks.end(), game,
+                [](uint32_t g, const ArchiveBlock& b) { return g < b.first_game; });
+            int number = (it - index.blocks.begin()) - 1;
+            if (number != current_block || game < current_game) {
+                if (!load_block(number)) { return false; }
+            }
+            while (current_game < game) {
+                string fen;
+                GameResult result;
+                const uint8_t* indices;
+                uint32_t plies;
+                if (!next_raw(fen, result, indices, plies)) { return false; }
+            }
+            return true;
+        }
+
+        // Reads the next game without replaying it. The move indices point into the block buffer,
+        // and stay valid until the next call.
+        bool next_raw(string& fen, GameResult& result, const uint8_t*& indices, uint32_t& plies) {
+            if (current_game >= index.games) { return false; }
+            if (current_block == -1 || block_position >= block.size()) {
+                if (!load_block(current_block + 1)) { return false; }
+            }
+            const uint8_t* data = block.data();
+            size_t end = block.size();
+            size_t position = block_position;
+            uint8_t flags = data[position++];
+            result = (GameResult)((flags >> 1) & 3);
+            plies = 0;
+            for (int shift = 0; position < end; shift += 7) {
+                uint8_t byte = data[position++];
+                plies |= (uint32_t)(byte & 127) << shift;
+                if ((byte & 128) == 0) { break; }
+            }
+            fen.clear();
+            if (flags & 1) {
+                if (position >= end) { return false; }
+                int length = data[position++];
+                if (position + length > end) { return false; }
+                fen.assign((const char*)data + position, length);
+                position += length;
+            }
+            if (position + plies > end) { return false; }
+            indices = data + position;
+            block_position = position + plies;
+            current_game++;
+            return true;
+        }
+
+        // Reads the next game and replays the move indices to moves
+        bool next(ArchiveGame& game) {
+            const uint8_t* indices;
+            uint32_t plies;
+            if (!next_raw(game.fen, game.result, indices, plies)) { return false; }
+            Position position;
+            if (!game.fen.empty() && !position.load_fen(game.fen)) { return false; }
+            game.moves.clear();
+            game.moves.reserve(plies);
+            PackedMove list[MAX_MOVES];
+            for (uint32_t i = 0; i < plies; i++) {
+                int count = archive_moves(position, list);
+                if (indices[i] >= count) { return false; }
+                PackedMove move = list[indices[i]];
+                if (!position.is_legal(move)) { return false; }
+                game.moves.push_back(move);
+                Undo undo;
+                position.do_move(move, undo);
+            }
+            return true;
+        }
+};
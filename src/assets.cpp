@@ -0,0 +1,124 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include <pack.cpp>
+#include <constants.h>
+
+using namespace std;
+
+// Calls work(i) for every i below count, spread over all cores
+template<typename F> void parallel_for(int count, F work) {
+    int threads = min(count, max(1, (int)thread::hardware_concurrency()));
+    atomic<int> next(0);
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (int i = next++; i < count; i = next++) { work(i); }
+        });
+    }
+    for (auto& w : workers) { w.join(); }
+}
+
+// Opens the files of the game by their path under SRC_PATH. They come from the asset pack if there is one,
+// the pack in the executable first and then PACK_PATH next to the assets, otherwise from the loose files.
+// Images can be decoded ahead of time on all cores, textures are then only created on the render thread.
+class Assets {
+    private:
+        AssetPack pack;
+        mutex lock;
+        map<string, SDL_Surface*> surfaces; // Decoded ahead of time, until they are used
+
+        // Name of a path in the pack, which is relative to SRC_PATH
+        string pack_name(string path) {
+            string prefix = SRC_PATH;
+            return path.compare(0, prefix.length(), prefix) == 0 ? path.substr(prefix.length()) : path;
+        }
+
+    public:
+        ~Assets() { release(); }
+
+        void open() {
+            if (pack.open_embedded()) { return; }
+            pack.open((string)SRC_PATH + PACK_PATH);
+        }
+
+        bool has_pack() { return pack.is_open(); }
+
+        // Opens a file for reading through SDL, returns NULL if there is no such file.
+        // Files from the pack are read straight from the mapped memory.
+        SDL_RWops* open_rw(string path) {
+            if (pack.is_open()) {
+                size_t size;
+                const uint8_t* data = pack.find(pack_name(path), size);
+                return data != NULL ? SDL_RWFromConstMem(data, size) : NULL;
+            }
+            return SDL_RWFromFile(path.c_str(), "rb");
+        }
+
+        // Paths of all files in a folder under SRC_PATH, e.g. "assets/sounds/"
+        vector<string> list(string folder) {
+            vector<string> paths;
+            if (pack.is_open()) {
+                for (auto& name : pack.list(folder)) { paths.push_back((string)SRC_PATH + name); }
+                return paths;
+            }
+            error_code error;
+            for (auto& entry : filesystem::directory_iterator((string)SRC_PATH + folder, error)) {
+                if (entry.is_regular_file()) { paths.push_back(entry.path().generic_string()); }
+            }
+            return paths;
+        }
+
+        // Decodes every image of a folder on all cores, so later loads only take the result
+        void preload_images(string folder) {
+            IMG_Init(IMG_INIT_PNG); // The decoder is loaded once here, and not by every thread at the same time
+            vector<string> paths = list(folder);
+            vector<SDL_Surface*> decoded(paths.size());
+            parallel_for(paths.size(), [&](int i) {
+                SDL_RWops* rw = open_rw(paths[i]);
+                decoded[i] = rw != NULL ? IMG_Load_RW(rw, 1) : NULL;
+            });
+            lock_guard<mutex> guard(lock);
+            for (size_t i = 0; i < paths.size(); i++) {
+                if (decoded[i] != NULL) { surfaces[paths[i]] = decoded[i]; }
+            }
+        }
+
+        // Returns the decoded image, which the caller frees, or NULL if it can't be loaded
+        SDL_Surface* load_image(string path) {
+            {
+                lock_guard<mutex> guard(lock);
+                auto it = surfaces.find(path);
+                if (it != surfaces.end()) {
+                    SDL_Surface* surface = it->second;
+                    surfaces.erase(it);
+                    return surface;
+                }
+            }
+            SDL_RWops* rw = open_rw(path);
+            return rw != NULL ? IMG_Load_RW(rw, 1) : NULL;
+        }
+
+        // Frees the images that were decoded but never used
+        void release() {
+            lock_guard<mutex> guard(lock);
+            for (auto& s : surfaces) { SDL_FreeSurface(s.second); }
+            surfaces.clear();
+        }
+};
+
+inline Assets& assets() {
+    static Assets instance;
+    return instance;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <vector>
+#include <filesystem>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+
+#include <assets.cpp>
+#include <constants.h>
+
+using namespace std;
+
+// Sound effects decoded to PCM once at startup, and played as chunks on a pool of mixer channels.
+// Nothing is decoded when a sound is played, and sounds are allowed to overlap.
+class Audio {
+    private:
+        map<string, Mix_Chunk*> chunks;
+        int channels;
+
+    public:
+        // Opens the audio device with the given buffer size (in sample frames) and loads every file in assets/sounds,
+        // decoded on all cores. Smaller buffers give lower latency, 256 frames at 44.1kHz is about 6ms.
+        bool init(int buffer_size, int channels) {
+            if ((Mix_Init(MIX_INIT_MP3) & MIX_INIT_MP3) == 0) {
+                cout << "Error initializing SDL_Mixer: " << Mix_GetError() << endl;
+                return false;
+            }
+            if (Mix_OpenAudio(AUDIO_FREQUENCY, MIX_DEFAULT_FORMAT, 2, buffer_size) != 0) {
+                cout << "Error opening audio device: " << Mix_GetError() << endl;
+                return false;
+            }
+            this->channels = Mix_AllocateChannels(channels);
+
+            vector<string> paths = assets().list("assets/sounds/");
+            if (paths.empty()) {
+                cout << "Cannot find: " << SRC_PATH << "assets/sounds" << endl;
+                return false;
+            }
+            vector<Mix_Chunk*> decoded(paths.size());
+            parallel_for(paths.size(), [&](int i) {
+                SDL_RWops* rw = assets().open_rw(paths[i]);
+                decoded[i] = rw != NULL ? Mix_LoadWAV_RW(rw, 1) : NULL;
+            });
+            for (size_t i = 0; i < paths.size(); i++) {
+                if (decoded[i] == NULL) {
+                    cout << "Cannot decode: " << paths[i] << endl;
+                    continue;
+                }
+                chunks[filesystem::path(paths[i]).stem().string()] = decoded[i];
+            }
+            return true;
+        }
+
+        // Plays the sound with the given name (the file name without extension).
+        // If every channel is busy the oldest sound is cut off instead of the new one.
+        void play(string name) {
+            auto it = chunks.find(name);
+            if (it == chunks.end()) { return; }
+            if (Mix_PlayChannel(-1, it->second, 0) == -1) {
+                int channel = Mix_GroupOldest(-1);
+                if (channel != -1) {
+                    Mix_HaltChannel(channel);
+                    Mix_PlayChannel(channel, it->second, 0);
+                }
+            }
+        }
+
+        // Frees all decoded sounds, called before the audio device is closed
+        void cleanup() {
+            Mix_HaltChannel(-1);
+            for (auto& c : chunks) { Mix_FreeChunk(c.second); }
+            chunks.clear();
+        }
+};
@@ -0,0 +1,603 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+
+#include <position.cpp>
+#include <mapped.cpp>
+
+using namespace std;
+
+// Endgame bitbases: win, draw or loss for the side to move in every position with the two kings and up to two
+// more pieces, e.g. KPK, KRK or KRKP. A table is named by the pieces of the stronger side, then the other side's.
+// Its positions are numbered by the squares of the kings and the pieces, and the side to move. Mirroring puts the
+// white king on the files a-d, and without pawns also into the triangle a1-d1-d4, which leaves an eighth of the
+// positions. Every position takes 2 bits.
+//
+// Tables are built by retrograde analysis. A first pass over all positions finds the mates, and the positions
+// decided by a capture or promotion, which leads into a smaller table that is built first. Then the results spread
+// backwards: a position that can move into a lost position is won, and one whose moves all lead into won positions
+// is lost. What is left when nothing changes any more is drawn. Both passes run on all cores.
+//
+// Bitbases know nothing of castling or en passant, positions where either is possible aren't probed. A double pawn
+// push next to an enemy pawn leads into such a position though: it's scored as the better for the opponent of the
+// table entry without the en passant square and of the capture.
+//
+// File layout, all numbers little endian and stored as they are in memory:
+//   header     BitbaseHeader
+//   directory  BitbaseTable for every table
+//   data       the tables, each starting at a multiple of BITBASE_ALIGNMENT
+
+#define BITBASE_VERSION 1
+#define BITBASE_PATH "bitbases.chbb"
+#define BITBASE_ALIGNMENT 64
+#define BITBASE_NAME_LENGTH 8 // Including the terminating 0
+#define BITBASE_CHUNK 4096 // Positions a thread takes at a time
+#define BITBASE_WIN_SCORE 20000 // Search score of a won position, below every mate score
+
+// Results for the side to move, as stored in the tables
+enum WDL { WDL_DRAW, WDL_WIN, WDL_LOSS, WDL_INVALID, WDL_UNKNOWN };
+
+typedef struct {
+    char magic[4]; // "CHBB"
+    uint32_t version;
+    uint32_t tables;
+    uint32_t reserved;
+} BitbaseHeader;
+
+typedef struct {
+    char name[BITBASE_NAME_LENGTH];
+    uint64_t offset; // From the start of the file
+    uint64_t positions;
+} BitbaseTable;
+
+static_assert(sizeof(BitbaseHeader) == 16 && sizeof(BitbaseTable) == 24, "The bitbase layout has to stay fixed");
+
+// Result for the other side
+inline WDL bitbase_flip(WDL result) {
+    return result == WDL_WIN ? WDL_LOSS : result == WDL_LOSS ? WDL_WIN : result;
+}
+
+// The better of two moves for the side to move, WDL_INVALID stands for a missing move. A move that is still
+// unknown may turn out to be the best unless the other one wins.
+inline WDL bitbase_better(WDL first, WDL second) {
+    if (first == WDL_INVALID || second == WDL_INVALID) { return first == WDL_INVALID ? second : first; }
+    if (first == WDL_WIN || second == WDL_WIN) { return WDL_WIN; }
+    if (first == WDL_UNKNOWN || second == WDL_UNKNOWN) { return WDL_UNKNOWN; }
+    return first == WDL_DRAW || second == WDL_DRAW ? WDL_DRAW : WDL_LOSS;
+}
+
+// Squares of the white king in the triangle a1-d1-d4, numbered, -1 for the others
+struct BitbaseTriangle {
+    int8_t index[64];
+    uint8_t square[10];
+
+    BitbaseTriangle() {
+        int n = 0;
+        for (int s = 0; s < 64; s++) {
+            bool inside = square_file(s) <= 3 && square_rank(s) <= square_file(s);
+            index[s] = inside ? n : -1;
+            if (inside) { square[n++] = s; }
+        }
+    }
+};
+
+static const BitbaseTriangle bitbase_triangle;
+
+// Letters of a side's pieces besides the king, the strongest first
+inline string bitbase_side(const PieceType* types, int count) {
+    string letters = "K";
+    for (PieceType type : { QUEEN, ROOK, BISHOP, KNIGHT, PAWN }) {
+        for (int i = 0; i < count; i++) {
+            if (types[i] == type) { letters += " PNBRQ"[type]; }
+        }
+    }
+    return letters;
+}
+
+// Checks if the second side has more material than the first, then the colors are swapped to find the table
+inline bool bitbase_stronger(const string& first, const string& second) {
+    if (first.length() != second.length()) { return second.length() > first.length(); }
+    for (size_t i = 1; i < first.length(); i++) {
+        if (first[i] != second[i]) { return strchr("QRBNP", second[i]) < strchr("QRBNP", first[i]); }
+    }
+    return false;
+}
+
+// Name of the table with the given material, with the stronger side first
+inline string bitbase_name(const PieceType* white, int white_count, const PieceType* black, int black_count) {
+    string w = bitbase_side(white, white_count), b = bitbase_side(black, black_count);
+    return bitbase_stronger(w, b) ? b + w : w + b;
+}
+
+// Pieces of a table besides the kings, and how its positions are numbered
+struct BitbaseLayout {
+    string name;
+    uint8_t pieces[2]; // In the order of the name, white's first
+    int count = 0;
+    bool pawns = false;
+    uint64_t positions = 0;
+
+    // Reads a name like "KRKP", returns false if it isn't a table of up to four pieces
+    bool parse(string text) {
+        size_t second = text.find('K', 1);
+        if (text.empty() || text[0] != 'K' || second == string::npos || text.length() > 4) { return false; }
+        name = text;
+        count = 0;
+        pawns = false;
+        for (size_t i = 1; i < text.length(); i++) {
+            if (i == second) { continue; }
+            const char* found = strchr(" PNBRQ", text[i]);
+            if (text[i] == ' ' || found == NULL) { return false; }
+            PieceType type = (PieceType)(found - " PNBRQ");
+            pieces[count++] = make_piece(type, i < second ? WHITE : BLACK);
+            pawns |= type == PAWN;
+        }
+        positions = 2ULL * (pawns ? 32 : 10) * 64;
+        for (int i = 0; i < count; i++) { positions *= 64; }
+        return true;
+    }
+
+    // Mirrors the squares at the diagonal a1-h8
+    void transpose(int* s) const {
+        for (int i = 0; i < count + 2; i++) { s[i] = (square_file(s[i]) << 3) | square_rank(s[i]); }
+    }
+
+    // Number of the squares as they are, equal pieces ordered by square
+    uint64_t encode(int* s, Color turn) const {
+        if (count == 2 && pieces[0] == pieces[1] && s[2] > s[3]) { swap(s[2], s[3]); }
+        uint64_t result = turn;
+        result = result * (pawns ? 32 : 10) + (pawns ? square_rank(s[0]) * 4 + square_file(s[0]) : bitbase_triangle.index[s[0]]);
+        for (int i = 1; i < count + 2; i++) { result = result * 64 + s[i]; }
+        return result;
+    }
+
+    // Number of a position, from the squares of the white king, the black king and the pieces in name order.
+    // Mirror images, and positions that only swap two equal pieces, get the same number.
+    uint64_t index(const int* squares, Color turn) const {
+        int s[4];
+        int n = count + 2;
+        memcpy(s, squares, n * sizeof(int));
+        if (square_file(s[0]) > 3) { for (int i = 0; i < n; i++) { s[i] ^= 7; } }
+        if (pawns) { return encode(s, turn); }
+        if (square_rank(s[0]) > 3) { for (int i = 0; i < n; i++) { s[i] ^= 56; } }
+        if (square_rank(s[0]) > square_file(s[0])) { transpose(s); }
+        if (square_rank(s[0]) != square_file(s[0])) { return encode(s, turn); }
+        uint64_t first = encode(s, turn); // The king is on the diagonal, both sides of it are the same position
+        transpose(s);
+        return min(first, encode(s, turn));
+    }
+
+    // Squares of a position from its number, returns false if it can't be a position, or if index numbers the
+    // position differently because it is the mirror image of another
+    bool decode(uint64_t number, int* squares, Color& turn) const {
+        uint64_t original = number;
+        int n = count + 2;
+        for (int i = n - 1; i > 0; i--) {
+            squares[i] = number % 64;
+            number /= 64;
+        }
+        int king = number % (pawns ? 32 : 10);
+        squares[0] = pawns ? make_square(king % 4, king / 4) : bitbase_triangle.square[king];
+        turn = (Color)(number / (pawns ? 32 : 10));
+        if (index(squares, turn) != original) { return false; }
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < i; j++) {
+                if (squares[i] == squares[j]) { return false; }
+            }
+        }
+        if (abs(square_file(squares[0]) - square_file(squares[1])) <= 1 && abs(square_rank(squares[0]) - square_rank(squares[1])) <= 1) {
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            int rank = square_rank(squares[i + 2]);
+            if (piece_type(pieces[i]) == PAWN && (rank == 0 || rank == 7)) { return false; }
+        }
+        return true;
+    }
+
+    // Sets up the position, returns false if the side that isn't to move is in check
+    bool setup(const int* squares, Color turn, Position& position) const {
+        uint8_t board[64] = { 0 };
+        board[squares[0]] = make_piece(KING, WHITE);
+        board[squares[1]] = make_piece(KING, BLACK);
+        for (int i = 0; i < count; i++) { board[squares[i + 2]] = pieces[i]; }
+        if (!position.load(board, turn, 0, NO_SQUARE, 0, 1)) { return false; }
+        return !position.is_attacked(position.king_square[!turn], turn);
+    }
+};
+
+// Tables that hold the results of positions, in memory or in a mapped file
+class Bitbases {
+    private:
+        struct Loaded {
+            BitbaseLayout layout;
+            const uint8_t* data;
+        };
+        map<string, Loaded> tables;
+        MappedFile file;
+
+    public:
+        Bitbases() {}
+        Bitbases(const Bitbases&) = delete;
+
+        // Maps a bitbase file, returns false if it doesn't exist or isn't one
+        bool open(string path) {
+            tables.clear();
+            if (!file.open(path, true)) { return false; }
+            const uint8_t* data = file.getData();
+            size_t size = file.getSize();
+            const BitbaseHeader* header = (const BitbaseHeader*)data;
+            bool valid = size >= sizeof(BitbaseHeader) && memcmp(header->magic, "CHBB", 4) == 0 &&
+                header->version == BITBASE_VERSION && header->tables <= (size - sizeof(BitbaseHeader)) / sizeof(BitbaseTable);
+            const BitbaseTable* directory = (const BitbaseTable*)(data + sizeof(BitbaseHeader));
+            for (uint32_t i = 0; valid && i < header->tables; i++) {
+                BitbaseLayout layout;
+                const BitbaseTable& table = directory[i];
+                valid = table.name[BITBASE_NAME_LENGTH - 1] == 0 && layout.parse(table.name) &&
+                    layout.positions == table.positions && table.offset <= size && (table.positions + 3) / 4 <= size - table.offset;
+                if (valid) { add(layout, data + table.offset); }
+            }
+            if (!valid) {
+                cout << "Not a bitbase file: " << path << endl;
+                tables.clear();
+                file.close();
+            }
+            return valid;
+        }
+
+        // Adds a table of 2 bits per position, which has to stay valid while it is used
+        void add(const BitbaseLayout& layout, const uint8_t* data) { tables[layout.name] = { layout, data }; }
+
+        bool is_open() { return !tables.empty(); }
+        bool has(string name) { return tables.count(name) != 0; }
+        size_t getCount() { return tables.size(); }
+
+        vector<string> getNames() {
+            vector<string> names;
+            for (auto& table : tables) { names.push_back(table.first); }
+            return names;
+        }
+
+        // Result of a position for the side to move, WDL_UNKNOWN if no table has it
+        WDL probe(const Position& position) {
+            if (position.castling != 0 || position.en_passant != NO_SQUARE || tables.empty()) { return WDL_UNKNOWN; }
+            PieceType types[2][2];
+            int count[2] = { 0, 0 };
+            for (int s = 0; s < 64; s++) {
+                uint8_t piece = position.squares[s];
+                if (piece == 0 || piece_type(piece) == KING) { continue; }
+                Color color = piece_color(piece);
+                if (count[WHITE] + count[BLACK] >= 2) { return WDL_UNKNOWN; }
+                types[color][count[color]++] = piece_type(piece);
+            }
+            if (count[WHITE] + count[BLACK] == 0) { return WDL_DRAW; } // Two bare kings
+            string w = bitbase_side(types[WHITE], count[WHITE]), b = bitbase_side(types[BLACK], count[BLACK]);
+            bool flipped = bitbase_stronger(w, b); // The colors are swapped, and the board mirrored vertically
+            auto it = tables.find(flipped ? b + w : w + b);
+            if (it == tables.end()) { return WDL_UNKNOWN; }
+            const BitbaseLayout& layout = it->second.layout;
+
+            int list[4];
+            list[0] = position.king_square[flipped ? BLACK : WHITE] ^ (flipped ? 56 : 0);
+            list[1] = position.king_square[flipped ? WHITE : BLACK] ^ (flipped ? 56 : 0);
+            bool used[64] = { false };
+            for (int i = 0; i < layout.count; i++) { // Each piece of the name takes the first square that holds it
+                uint8_t wanted = layout.pieces[i];
+                if (flipped) { wanted = make_piece(piece_type(wanted), (Color)!piece_color(wanted)); }
+                for (int s = 0; s < 64; s++) {
+                    if (position.squares[s] == wanted && !used[s]) {
+                        used[s] = true;
+                        list[i + 2] = s ^ (flipped ? 56 : 0);
+                        break;
+                    }
+                }
+            }
+            uint64_t number = layout.index(list, flipped ? (Color)!position.turn : position.turn);
+            return (WDL)((it->second.data[number / 4] >> (2 * (number % 4))) & 3);
+        }
+};
+
+// Builds tables and the smaller ones they lead into, and writes them to a file
+class BitbaseGenerator {
+    private:
+        int threads;
+        Bitbases finished;
+        map<string, vector<uint8_t>> data; // 2 bits per position of every finished table
+
+        // Runs the function on all threads, for chunks of the numbers below count
+        void parallel_for(uint64_t count, function<void(uint64_t, uint64_t, int)> work) {
+            atomic<uint64_t> next(0);
+            vector<thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t]() {
+                    for (uint64_t begin = next.fetch_add(BITBASE_CHUNK); begin < count; begin = next.fetch_add(BITBASE_CHUNK)) {
+                        work(begin, min(count, begin + BITBASE_CHUNK), t);
+                    }
+                });
+            }
+            for (auto& w : workers) { w.join(); }
+        }
+
+        // Tables a table leads into by captures and promotions
+        vector<string> successors(const BitbaseLayout& layout) {
+            vector<string> names;
+            vector<PieceType> sides[2];
+            for (int i = 0; i < layout.count; i++) { sides[piece_color(layout.pieces[i])].push_back(piece_type(layout.pieces[i])); }
+            for (int color = 0; color < 2; color++) {
+                for (size_t i = 0; i < sides[color].size(); i++) {
+                    vector<PieceType> changed[2] = { sides[0], sides[1] };
+                    changed[color].erase(changed[color].begin() + i);
+                    if (!changed[WHITE].empty() || !changed[BLACK].empty()) {
+                        names.push_back(bitbase_name(changed[WHITE].data(), changed[WHITE].size(), changed[BLACK].data(), changed[BLACK].size()));
+                    }
+                    if (sides[color][i] != PAWN) { continue; }
+                    for (PieceType promotion : { KNIGHT, BISHOP, ROOK, QUEEN }) {
+                        changed[color] = sides[color];
+                        changed[color][i] = promotion;
+                        names.push_back(bitbase_name(changed[WHITE].data(), changed[WHITE].size(), changed[BLACK].data(), changed[BLACK].size()));
+                    }
+                }
+            }
+            return names;
+        }
+
+        // Best result for the opponent of capturing en passant after a move, WDL_INVALID if the move isn't a double
+        // pawn push that allows it. The capture always leads into a finished table.
+        WDL en_passant_result(Position& position, PackedMove move) {
+            int from = move_from(move), to = move_to(move);
+            if (piece_type(position.squares[from]) != PAWN || abs(to - from) != 16) { return WDL_INVALID; }
+            WDL best = WDL_INVALID;
+            Undo undo;
+            position.do_move(move, undo);
+            if (position.en_passant != NO_SQUARE) {
+                PackedMove list[MAX_MOVES];
+                int count = position.generate_moves(list);
+                for (int i = 0; i < count; i++) {
+                    if (!position.is_en_passant(list[i])) { continue; }
+                    Undo capture;
+                    position.do_move(list[i], capture);
+                    best = bitbase_better(best, bitbase_flip(finished.probe(position)));
+                    position.undo_move(list[i], capture);
+                }
+            }
+            position.undo_move(move, undo);
+            return best;
+        }
+
+        // Result of a position in the table being built, or in a finished one after a capture or promotion
+        WDL result(const BitbaseLayout& layout, const vector<atomic<uint8_t>>& status, Position& position,
+                   const int* squares, PackedMove move) {
+            bool exits = position.squares[move_to(move)] != 0 || move_promotion(move) != NO_PIECE_TYPE;
+            if (!exits) {
+                int moved[4];
+                memcpy(moved, squares, sizeof(moved));
+                for (int i = 0; i < layout.count + 2; i++) {
+                    if (moved[i] == move_from(move)) { moved[i] = move_to(move); }
+                }
+                WDL entry = (WDL)status[layout.index(moved, (Color)!position.turn)].load(memory_order_relaxed);
+                return bitbase_better(entry, en_passant_result(position, move));
+            }
+            Undo undo;
+            position.do_move(move, undo);
+            WDL found = finished.probe(position);
+            position.undo_move(move, undo);
+            return found;
+        }
+
+        // Checks if every move of the position leads into a position the opponent wins
+        bool all_moves_lose(const BitbaseLayout& layout, const vector<atomic<uint8_t>>& status, Position& position,
+                            const int* squares) {
+            PackedMove list[MAX_MOVES];
+            int count = position.generate_moves(list);
+            for (int i = 0; i < count; i++) {
+                if (result(layout, status, position, squares, list[i]) != WDL_WIN) { return false; }
+            }
+            return true;
+        }
+
+        // Numbers of the positions the side that isn't to move came from with a move inside the table, with the move if
+        // it was a double pawn push, NULL_MOVE otherwise
+        void predecessors(const BitbaseLayout& layout, Position& position, const int* squares,
+                          vector<pair<uint64_t, PackedMove>>& found) {
+            Color mover = (Color)!position.turn;
+            Color turn = position.turn;
+            position.turn = mover; // Generates the moves of the other side from the same squares
+            for (int i = 0; i < layout.count + 2; i++) {
+                int from = squares[i];
+                uint8_t piece = position.squares[from];
+                if (piece_color(piece) != mover) { continue; }
+                int targets[MAX_PIECE_MOVES], n = 0;
+                if (piece_type(piece) == PAWN) { // Pawns step back, two squares back onto their start rank
+                    int back = mover == WHITE ? -8 : 8;
+                    int rank = square_rank(from + back);
+                    if (rank != 0 && rank != 7 && position.squares[from + back] == 0) {
+                        targets[n++] = from + back;
+                        if (rank == (mover == WHITE ? 2 : 5) && position.squares[from + 2 * back] == 0) { targets[n++] = from + 2 * back; }
+                    }
+                }
+                else { // Other pieces move back the way they move forward
+                    PackedMove list[MAX_PIECE_MOVES];
+                    int count = position.generate_piece_moves(from, list, 0, GEN_QUIET);
+                    for (int j = 0; j < count; j++) { targets[n++] = move_to(list[j]); }
+                }
+                int moved[4];
+                memcpy(moved, squares, sizeof(moved));
+                for (int j = 0; j < n; j++) {
+                    moved[i] = targets[j];
+                    bool pushed = piece_type(piece) == PAWN && abs(targets[j] - from) == 16;
+                    found.push_back({ layout.index(moved, mover), pushed ? make_move(targets[j], from) : NULL_MOVE });
+                }
+            }
+            position.turn = turn;
+        }
+
+        bool build(const BitbaseLayout& layout) {
+            vector<atomic<uint8_t>> status(layout.positions);
+            vector<vector<uint64_t>> frontier(threads);
+
+            // Mates, invalid positions, and positions decided by leaving the table
+            parallel_for(layout.positions, [&](uint64_t begin, uint64_t end, int t) {
+                Position position;
+                int squares[4];
+                Color turn;
+                PackedMove list[MAX_MOVES];
+                for (uint64_t number = begin; number < end; number++) {
+                    if (!layout.decode(number, squares, turn) || !layout.setup(squares, turn, position)) {
+                        status[number] = WDL_INVALID;
+                        continue;
+                    }
+                    int count = position.generate_moves(list);
+                    WDL value = count == 0 ? (position.in_check() ? WDL_LOSS : WDL_DRAW) : WDL_UNKNOWN;
+                    bool all_lose = count > 0;
+                    for (int i = 0; i < count && value == WDL_UNKNOWN; i++) {
+                        bool exits = position.squares[move_to(list[i])] != 0 || move_promotion(list[i]) != NO_PIECE_TYPE;
+                        if (!exits) { // Only decided here if capturing en passant wins for the opponent
+                            if (en_passant_result(position, list[i]) != WDL_WIN) { all_lose = false; }
+                            continue;
+                        }
+                        Undo undo;
+                        position.do_move(list[i], undo);
+                        WDL next = finished.probe(position);
+                        position.undo_move(list[i], undo);
+                        if (next == WDL_LOSS) { value = WDL_WIN; }
+                        else if (next != WDL_WIN) { all_lose = false; }
+                    }
+                    if (value == WDL_UNKNOWN && all_lose) { value = WDL_LOSS; }
+                    status[number] = value;
+                    if (value == WDL_WIN || value == WDL_LOSS) { frontier[t].push_back(number); }
+                }
+            });
+
+            // Spreads the results backwards until nothing changes
+            vector<uint64_t> current;
+            int passes = 0;
+            for (;;) {
+                current.clear();
+                for (auto& f : frontier) {
+                    current.insert(current.end(), f.begin(), f.end());
+                    f.clear();
+                }
+                if (current.empty()) { break; }
+                passes++;
+                parallel_for(current.size(), [&](uint64_t begin, uint64_t end, int t) {
+                    Position position, previous;
+                    int squares[4], before[4];
+                    Color turn;
+                    vector<pair<uint64_t, PackedMove>> found;
+                    for (uint64_t i = begin; i < end; i++) {
+                        uint64_t number = current[i];
+                        layout.decode(number, squares, turn);
+                        layout.setup(squares, turn, position);
+                        WDL value = (WDL)status[number].load(memory_order_relaxed);
+                        found.clear();
+                        predecessors(layout, position, squares, found);
+                        for (auto& entry : found) {
+                            uint64_t earlier = entry.first;
+                            PackedMove push = entry.second;
+                            uint8_t unknown = WDL_UNKNOWN;
+                            if (status[earlier].load(memory_order_relaxed) != WDL_UNKNOWN) { continue; }
+                            if (value == WDL_LOSS && push != NULL_MOVE) { // Unless capturing en passant saves the opponent
+                                memcpy(before, squares, sizeof(before)); // Not mirrored like a decoded number, as the move
+                                for (int j = 0; j < layout.count + 2; j++) {
+                                    if (before[j] == move_to(push)) { before[j] = move_from(push); }
+                                }
+                                layout.setup(before, (Color)!position.turn, previous);
+                                if (result(layout, status, previous, before, push) != WDL_LOSS) { continue; }
+                            }
+                            if (value == WDL_WIN) { // Lost if every move leads into a won position
+                                layout.decode(earlier, before, turn);
+                                layout.setup(before, turn, previous);
+                                if (!all_moves_lose(layout, status, previous, before)) { continue; }
+                                if (status[earlier].compare_exchange_strong(unknown, WDL_LOSS)) { frontier[t].push_back(earlier); }
+                            }
+                            else if (status[earlier].compare_exchange_strong(unknown, WDL_WIN)) { frontier[t].push_back(earlier); }
+                        }
+                    }
+                });
+            }
+
+            // The positions left are drawn
+            vector<uint8_t>& packed = data[layout.name];
+            packed.assign((layout.positions + 3) / 4, 0);
+            uint64_t counts[4] = { 0, 0, 0, 0 };
+            for (uint64_t number = 0; number < layout.positions; number++) {
+                uint8_t value = status[number] == WDL_UNKNOWN ? (uint8_t)WDL_DRAW : status[number].load();
+                packed[number / 4] |= value << (2 * (number % 4));
+                counts[value]++;
+            }
+            finished.add(layout, packed.data());
+            cout << layout.name << ": " << counts[WDL_WIN] << " won, " << counts[WDL_DRAW] << " drawn, " << counts[WDL_LOSS]
+                 << " lost, " << counts[WDL_INVALID] << " invalid, " << passes << " passes" << endl;
+            return true;
+        }
+
+    public:
+        BitbaseGenerator(int threads) : threads(max(1, threads)) {}
+
+        // Builds a table, after the tables it leads into
+        bool generate(string name) {
+            BitbaseLayout layout;
+            if (!layout.parse(name)) {
+                cout << "Not a table of three or four pieces: " << name << endl;
+                return false;
+            }
+            if (finished.has(name)) { return true; }
+            for (string next : successors(layout)) {
+                if (!generate(next)) { return false; }
+            }
+            return build(layout);
+        }
+
+        bool write(string path) {
+            ofstream out(path, ios::binary | ios::trunc);
+            if (!out) {
+                cout << "Cannot write: " << path << endl;
+                return false;
+            }
+            vector<BitbaseTable> directory;
+            uint64_t offset = sizeof(BitbaseHeader) + data.size() * sizeof(BitbaseTable);
+            for (auto& table : data) {
+                BitbaseTable entry;
+                memset(&entry, 0, sizeof(entry));
+                strcpy(entry.name, table.first.c_str());
+                offset = (offset + BITBASE_ALIGNMENT - 1) / BITBASE_ALIGNMENT * BITBASE_ALIGNMENT;
+                entry.offset = offset;
+                BitbaseLayout layout;
+                layout.parse(table.first);
+                entry.positions = layout.positions;
+                directory.push_back(entry);
+                offset += table.second.size();
+            }
+            BitbaseHeader header = { { 'C', 'H', 'B', 'B' }, BITBASE_VERSION, (uint32_t)directory.size(), 0 };
+            out.write((const char*)&header, sizeof(header));
+            out.write((const char*)directory.data(), directory.size() * sizeof(BitbaseTable));
+            uint64_t position = sizeof(BitbaseHeader) + directory.size() * sizeof(BitbaseTable);
+            size_t i = 0;
+            for (auto& table : data) {
+                string padding(directory[i].offset - position, '\0');
+                out.write(padding.data(), padding.size());
+                out.write((const char*)table.second.data(), table.second.size());
+                position = directory[i].offset + table.second.size();
+                i++;
+            }
+            return (bool)out;
+        }
+};
+
+// Bitbases from BITBASE_PATH, mapped on first use. Without the file every probe is WDL_UNKNOWN.
+inline Bitbases& bitbases() {
+    static Bitbases instance;
+    static once_flag opened;
+    call_once(opened, []() { instance.open(BITBASE_PATH); });
+    return instance;
+}
@@ -4,29 +4,32 @@
 #include <bits/stdc++.h>
 
 #include <pieces.cpp>
+#include <position.cpp>
 
 using namespace std;
 
+#define LEGAL_CACHE_SIZE 4096 // Positions kept in the legal move cache before it is cleared
+
+// Castling rights, en passant field and halfmove clock, the part of a position that can't be seen from the pieces
+typedef struct {
+    int castling;
+    string en_passant;
+    int halfmove_clock;
+} RulesState;
+
 // Struct to represent moves on the board
 typedef struct {
     Piece* piece;
     string from, to;
     bool piece_captured;
     bool pawn_swapped;
+    bool en_passant;
+    Piece* rook; // The rook moved by castling, otherwise NULL
+    string rook_from, rook_to;
+    RulesState before, after;
+    PieceType promotion; // The piece chosen for a promoted pawn
 } Move;
 
-// Enum to represent the current state of the board
-enum State { 
-    NEUTRAL, 
-    WHITE_CHECK, 
-    BLACK_CHECK, 
-    WHITE_CHECKMATE, 
-    BLACK_CHECKMATE, 
-    WHITE_TIMES_UP,
-    BLACK_TIMES_UP,
-    TIE
-};
-
 // Class to represent the board, and keep all its functionality
 class Board {
     private:
@@ -38,6 +41,8 @@ class Board {
         vector<Move> moves;
         Entity last_move[2];
         vector<string> valid_fields;
+        vector<Entity> valid_dots;
+        unordered_map<uint64_t, vector<PackedMove>> legal_cache;
         vector <Piece*> pieces;
         vector<Piece*> captured_pieces;
         vector<Piece*> swapped_pieces;
@@ -46,6 +51,34 @@ class Board {
         Piece* white_king;
         Piece* black_king;
         Color turn;
+        RulesState rules;
+        vector<uint64_t> history; // Keys of the positions before each move, up to the current move
+        SDL_Texture* layer;
+        Piece* layer_animation;
+        bool layer_dirty;
+
+        // Draws the board, the highlighted fields and every piece that isn't animated into the layer texture
+        void render_layer(SDL_Renderer* renderer) {
+            if (layer == NULL) {
+                layer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                    entity.x + entity.w, entity.y + entity.h);
+            }
+            SDL_Texture* target = SDL_GetRenderTarget(renderer);
+            SDL_SetRenderTarget(renderer, layer);
+            this->entity.render(renderer);
+            last_move[0].render(renderer);
+            last_move[1].render(renderer);
+            if (sel_piece != NULL) { sel_field.render(renderer); }
+            for (auto& p : pieces) {
+                if (p != animation) { p->render(renderer); }
+            }
+            if (sel_piece != NULL) {
+                for (auto& dot : valid_dots) { dot.render(renderer); }
+            }
+            SDL_SetRenderTarget(renderer, target);
+            layer_animation = animation;
+            layer_dirty = false;
+        }
 
     public:
         Board(int size, int x, int y) {
@@ -55,6 +88,13 @@ class Board {
             this->sel_field = Entity(x, y, this->size / 8, this->size / 8, "selected_field.png");
             this->last_move[0] = Entity(-10000, -10000, this->size / 8, this->size / 8, "previous_field.png");
             this->last_move[1] = Entity(-10000, -10000, this->size / 8, this->size / 8, "previous_field.png");
+            this->layer = NULL;
+            this->layer_animation = NULL;
+            this->layer_dirty = true;
+            this->sel_piece = NULL;
+            this->animation = NULL;
+            this->pawn_swapping = false;
+            this->board_updated = false;
         }
 
         // Public getters and setters
@@ -65,9 +105,45 @@ class Board {
         Entity getEntity() { return entity; }
         vector<Move> getMoves() { return moves; }
         Color getTurn() { return turn; }
+        const vector<PackedMove>& getLegalMoves() { return legal_moves(); }
+        uint64_t getPositionKey() { return position_key(); }
+        // The shown position in the compact representation, with the earlier keys so repetitions are found
+        Position getPosition() {
+            Position position;
+            memset(position.squares, 0, sizeof(position.squares));
+            for (auto& p : pieces) {
+                int square = parse_square(p->getField());
+                position.squares[square] = make_piece(p->getType(), p->getColor());
+                if (p->getType() == KING) { position.king_square[p->getColor()] = square; }
+            }
+            position.turn = side_to_move();
+            position.castling = rules.castling;
+            position.en_passant = rules.en_passant.empty() ? NO_SQUARE : parse_square(rules.en_passant);
+            position.halfmove_clock = rules.halfmove_clock;
+            position.fullmove = current_move / 2 + 1;
+            position.key = position.compute_key();
+            position.history = history;
+            return position;
+        }
+
+        // All moves of the game in the compact format, without a promotion that is still being chosen
+        vector<PackedMove> getPackedMoves() {
+            vector<PackedMove> packed;
+            for (auto& move : moves) {
+                if (move.pawn_swapped && move.promotion == NO_PIECE_TYPE) { break; }
+                packed.push_back(make_move(parse_square(move.from), parse_square(move.to), move.promotion));
+            }
+            return packed;
+        }
         State state;
         Piece* animation;
 
+        // True if the next call to render() has to redraw the cached layer
+        bool needs_render() { return layer_dirty || animation != layer_animation; }
+
+        // Forces the cached layer to be redrawn, e.g. when the render targets were reset
+        void invalidate() { layer_dirty = true; }
+
         // Reset the board, called to start a new game
         void reset() {
             // cleanup memory
@@ -78,15 +154,22 @@ class Board {
             swap_selection.clear();
             swapped_pieces.clear();
             moves.clear();
+            legal_cache.clear();
+            history.clear();
             state = NEUTRAL;
             current_move = 0;
             turn = WHITE;
+            rules = { ALL_CASTLING, "", 0 };
             last_move[0].x = -10000;
             last_move[1].x = -10000;
+            sel_piece = NULL;
+            animation = NULL;
+            pawn_swapping = false;
+            layer_dirty = true;
 
             // Init white side
             for (int i = 0; i < 8; i++) {
-                char field[2] = {i+65, 50};
+                string field = {char(i+65), 50};
                 pieces.push_back(new Pawn(size, entity.x, entity.y, field, WHITE));
             }
             pieces.push_back(new Rook(size, entity.x, entity.y, "A1", WHITE));
@@ -101,7 +184,7 @@ class Board {
 
             // Init black side
             for (int i = 0; i < 8; i++) {
-                char field[2] = {i+65, 55};
+                string field = {char(i+65), 55};
                 pieces.push_back(new Pawn(size, entity.x, entity.y, field, BLACK));
             }
             pieces.push_back(new Rook(size, entity.x, entity.y, "A8", BLACK));
@@ -114,14 +197,12 @@ class Board {
             black_king = new King(size, entity.x, entity.y, "E8", BLACK);
             pieces.push_back(black_king);
 
-            for (auto& p : pieces) {
-                p->update_target_fields(pieces);
-            }
+            update_targets();
         }
 
         // Checks which field the mouse clicked, and updates the selected piece
         void check_mouse_hit(int x, int y) {
-            char field[2];
+            char field[3] = { 0, 0, 0 };
             for (int i = 0; i < 9; i++) {
                 if (x >= this->entity.x + (size / 8) * i && x < this->entity.x + (size / 8) * (i + 1)) {
                     field[0] = 65 + i;
@@ -137,6 +218,29 @@ class Board {
                 field_update(field);
             }
             else { sel_piece = NULL; }
+            layer_dirty = true;
+        }
+
+        // Plays a move the same way as clicking it, including the choice of a promotion piece.
+        // Returns false if it can't be played in the current position.
+        bool play_move(PackedMove move) {
+            if (pawn_swapping || current_move != moves.size()) { return false; }
+            field_select(square_name(move_from(move)));
+            if (sel_piece == NULL) { return false; }
+            int count = moves.size();
+            field_update(square_name(move_to(move)));
+            layer_dirty = true;
+            if (moves.size() == count) { return false; }
+            if (pawn_swapping) {
+                PieceType promotion = move_promotion(move) == NO_PIECE_TYPE ? QUEEN : move_promotion(move);
+                for (auto& p : swap_selection) {
+                    if (p->getType() == promotion) {
+                        check_swap_hit(p->getField());
+                        break;
+                    }
+                }
+            }
+            return true;
         }
 
         // Rewind one move
@@ -146,6 +250,10 @@ class Board {
                 update_last_move(move.from, move.to);
                 move.piece->update_field(move.from);
                 move.piece->update_position();
+                if (move.rook != NULL) {
+                    move.rook->update_field(move.rook_from);
+                    move.rook->update_position();
+                }
                 if (move.piece_captured) {
                     pieces.push_back(captured_pieces.back());
                     captured_pieces.pop_back();
@@ -157,9 +265,13 @@ class Board {
                     swapped_pieces.insert(swapped_pieces.begin(), swapped_pieces.back());
                     swapped_pieces.pop_back();
                 }
+                rules = move.before;
+                history.pop_back();
                 current_move--;
                 if (current_move > 0) { move = moves.at(current_move - 1); }
                 update_last_move(move.from, move.to);
+                update_targets();
+                layer_dirty = true;
             }
         }
 
@@ -167,10 +279,13 @@ class Board {
         void fast_forward() {
             if (!moves.empty() && current_move < moves.size()) {
                 Move move = moves.at(current_move);
+                history.push_back(position_key());
                 update_last_move(move.from, move.to);
                 if (move.piece_captured) {
+                    string captured_field = move.to;
+                    if (move.en_passant) { captured_field = { move.to[0], move.from[1] }; }
                     for (int i = 0; i < pieces.size(); i++) {
-                        if (pieces.at(i)->getField() == move.to) {
+                        if (pieces.at(i)->getField() == captured_field) {
                             captured_pieces.push_back(pieces.at(i));
                             pieces.erase(pieces.begin() + i);
                             break;
@@ -179,6 +294,10 @@ class Board {
                 }
                 move.piece->update_field(move.to);
                 move.piece->update_position();
+                if (move.rook != NULL) {
+                    move.rook->update_field(move.rook_to);
+                    move.rook->update_position();
+                }
                 if (move.pawn_swapped) {
                     pieces.insert(pieces.begin(), swapped_pieces.front());
                     auto it = find(pieces.begin(), pieces.end(), move.piece);
@@ -186,18 +305,20 @@ class Board {
                     swapped_pieces.push_back(swapped_pieces.front());
                     swapped_pieces.erase(swapped_pieces.begin());                 
                 }
+                rules = move.after;
                 update_last_move(move.from, move.to);
                 current_move++;
+                update_targets();
+                layer_dirty = true;
             }
         }
 
-        // General render function 
+        // General render function, the static part of the board is cached in a render target texture
+        // and only redrawn when a move, rewind or selection changes it
         void render(SDL_Renderer* renderer) {
-            this->entity.render(renderer);
-            last_move[0].render(renderer);
-            last_move[1].render(renderer);
-            if (sel_piece != NULL) { sel_field.render(renderer); }
-            for (auto& p : pieces) { p->render(renderer); }
+            if (needs_render() || layer == NULL) { render_layer(renderer); }
+            SDL_Rect rect = { entity.x, entity.y, entity.w, entity.h };
+            SDL_RenderCopy(renderer, layer, &rect, &rect);
             
             if (pawn_swapping) { // Render pawn swapper GUI
                 SDL_Rect rect = { entity.x + entity.w, entity.y + 2 * (entity.h / 8), entity.w / 8, 4 * (entity.h / 8) };
@@ -216,6 +337,9 @@ class Board {
                     if (new_field == valid_field) {
                         field_updated = true;
                         string saved_field = sel_piece->getField();
+                        string captured_field = capture_field(sel_piece, new_field);
+                        RulesState before = rules;
+                        history.push_back(position_key());
                         sel_piece->update_field(new_field);
 
                         if (sel_piece->isPawn()) { // Check if there's a pawn swap
@@ -229,26 +353,35 @@ class Board {
                         int i = pieces.size() - 1;  
                         for (; i >= 0; i--) { // Check if a piece was captured
                             auto& p = pieces[i];  
-                            if (new_field == p->getField() && turn != p->getColor()) {
+                            if (captured_field == p->getField() && turn != p->getColor()) {
                                 captured_pieces.push_back(p);
                                 pieces.erase(pieces.begin() + i);
                                 piece_captured = true;
                                 break;
                             }
                         }
-                        for (auto& p : pieces) {
-                            p->update_target_fields(pieces);
+                        Piece* rook = NULL;
+                        string rook_from, rook_to;
+                        if (sel_piece->getType() == KING && abs(new_field[0] - saved_field[0]) == 2) { // Castling moves the rook too
+                            rook_from = { new_field[0] > saved_field[0] ? 'H' : 'A', saved_field[1] };
+                            rook_to = { char((saved_field[0] + new_field[0]) / 2), saved_field[1] };
+                            rook = piece_at(rook_from);
+                            rook->update_field(rook_to);
+                            rook->update_position();
                         }
+                        update_rules(sel_piece, saved_field, new_field, piece_captured);
+                        update_targets();
                         // Final calls for when a piece is moved
-                        Move last_move = { sel_piece, saved_field, new_field, piece_captured, pawn_swapping };
+                        Move last_move = { sel_piece, saved_field, new_field, piece_captured, pawn_swapping,
+                            captured_field != new_field, rook, rook_from, rook_to, before, rules, NO_PIECE_TYPE };
                         update_last_move(last_move.from, last_move.to);
                         moves.push_back(last_move);
                         current_move++;
+                        if (turn == WHITE) { turn = BLACK; }
+                        else { turn = WHITE; }
                         check_board_state();
                         animation = sel_piece;
                         board_updated = true;
-                        if (turn == WHITE) { turn = BLACK; }
-                        else { turn = WHITE; }
                         break;
                     }
                 }
@@ -263,8 +396,18 @@ class Board {
                 if (new_field == p->getField() && turn == p->getColor()) {
                     sel_piece = p;
                     valid_fields.clear();
-                    for (auto& f : p->getTargetFields()) {
-                        if (validate_field(p, f)) { valid_fields.push_back(f); }
+                    valid_dots.clear();
+                    int from = parse_square(new_field);
+                    for (auto& move : legal_moves()) {
+                        PieceType promotion = move_promotion(move); // One field for the four promotions
+                        if (move_from(move) == from && (promotion == NO_PIECE_TYPE || promotion == QUEEN)) {
+                            valid_fields.push_back(square_name(move_to(move)));
+                            Entity dot = sel_field;
+                            dot.path = (string)SRC_PATH + "assets/textures/dot.png";
+                            dot.x = entity.x + dot.w * square_file(move_to(move));
+                            dot.y = entity.y + dot.h * (7 - square_rank(move_to(move)));
+                            valid_dots.push_back(dot);
+                        }
                     }
                     sel_field.x = p->getEntity().x;
                     sel_field.y = p->getEntity().y;
@@ -292,6 +435,7 @@ class Board {
                 if (field == p->getField()) { 
                     pawn_swapping = false;
                     Piece* pawn = moves.back().piece;
+                    moves.back().promotion = p->getType();
                     p->update_field(pawn->getField());
                     p->update_position();
                     auto it = find(pieces.begin(), pieces.end(), pawn);
@@ -299,9 +443,7 @@ class Board {
                     swapped_pieces.push_back(p);
                     pieces.insert(pieces.begin(), p);
 
-                    for (auto& p : pieces) {
-                        p->update_target_fields(pieces);
-                    }
+                    update_targets();
                     check_board_state();
                     board_updated = true;
                 }
@@ -326,73 +468,123 @@ class Board {
             return check;
         }
 
-        // Checks if the given color has a valid move on the board
-        bool valid_moves(Color color) {
+        // The side to move in the shown position, which differs from turn while rewinding
+        Color side_to_move() {
+            return (moves.size() - current_move) % 2 == 0 ? turn : (Color)!turn;
+        }
+
+        // Hash of the pieces, the side to move and the rules state, the same key a Position gets for this position
+        uint64_t position_key() {
+            uint64_t key = side_to_move() == WHITE ? zobrist.turn : 0;
             for (auto& p : pieces) {
-                if (color == p->getColor()) {
-                    for (auto& new_field : p->getTargetFields()) {
-                        if (validate_field(p, new_field)) { 
-                            return true;                        
-                        }
-                    }
-                }
+                key ^= zobrist.pieces[make_piece(p->getType(), p->getColor())][parse_square(p->getField())];
             }
-            return false;
+            key ^= zobrist.castling[rules.castling];
+            if (!rules.en_passant.empty()) { key ^= zobrist.en_passant[rules.en_passant[0] - 'A']; }
+            return key;
         }
 
-        // Moves a piece and checks if the move was valid, then undo's the change and returns true or false
-        bool validate_field(Piece* piece, string new_field) {
-            bool valid = true;
-            string saved_field = piece->getField();
-            piece->update_field(new_field);
-            bool piece_was_captured = false;
-            int i = pieces.size() - 1;  
-            for (; i >= 0; i--) { // Check if a piece was captured
-                auto& p = pieces[i];  
-                if (new_field == p->getField() && piece->getColor() != p->getColor()) {
-                    piece_was_captured = true;
-                    captured_pieces.push_back(p);
-                    pieces.erase(pieces.begin() + i);
-                    break;
-                }
-            } 
+        // Counts how often the shown position occurred before. Only positions with the same side to move
+        // since the last capture or pawn move can be equal, so at most halfmove_clock / 2 keys are compared.
+        int repetitions() {
+            uint64_t key = position_key();
+            int count = 0;
+            int limit = max(0, current_move - rules.halfmove_clock);
+            for (int i = current_move - 2; i >= limit; i -= 2) {
+                if (history[i] == key) { count++; }
+            }
+            return count;
+        }
+
+        // Passes the rules state to the pieces and updates all target fields
+        void update_targets() {
+            count_metric(METRIC_TARGET_UPDATES, pieces.size());
             for (auto& p : pieces) {
+                p->update_rules(rules.castling, rules.en_passant);
                 p->update_target_fields(pieces);
             }
-            if ((piece->getColor() == WHITE && is_check(white_king)) || 
-            (piece->getColor() == BLACK && is_check(black_king))) {
-                valid = false;
-            }
-            piece->update_field(saved_field); //undo the change
-            if (piece_was_captured) { // Restore the potentially captured piece
-                pieces.insert(pieces.begin() + i, captured_pieces.back());
-                captured_pieces.pop_back();
+        }
+
+        // Updates the castling rights, en passant field and halfmove clock after a piece moved
+        void update_rules(Piece* piece, string from, string to, bool piece_captured) {
+            rules.castling &= move_tables.castling_mask[parse_square(from)] & move_tables.castling_mask[parse_square(to)];
+            rules.halfmove_clock = piece->isPawn() || piece_captured ? 0 : rules.halfmove_clock + 1;
+            rules.en_passant = "";
+            if (piece->isPawn() && abs(to[1] - from[1]) == 2) {
+                // Only set when an opponent pawn can use it, the same as in Position, so repetitions are found
+                for (auto& p : pieces) {
+                    if (p->isPawn() && p->getColor() != piece->getColor() && p->getField()[1] == to[1] &&
+                    abs(p->getField()[0] - to[0]) == 1) {
+                        rules.en_passant = { to[0], char((from[1] + to[1]) / 2) };
+                        break;
+                    }
+                }
             }
+        }
+
+        // The field of the piece captured by moving to the new field, which is behind it for en passant
+        string capture_field(Piece* piece, string new_field) {
+            if (piece->isPawn() && new_field == rules.en_passant) { return { new_field[0], piece->getField()[1] }; }
+            return new_field;
+        }
+
+        Piece* piece_at(string field) {
             for (auto& p : pieces) {
-                p->update_target_fields(pieces);        
+                if (p->getField() == field) { return p; }
             }
-            return valid;
+            return NULL;
         }
 
-        // check the board current state
+        // Legal moves of the side to move, promotions included. They are generated by the compact position once
+        // per position and cached by its key, so selecting pieces, checking the state and the move list all share
+        // the same work.
+        const vector<PackedMove>& legal_moves() {
+            uint64_t key = position_key();
+            auto it = legal_cache.find(key);
+            if (it != legal_cache.end()) {
+                count_metric(METRIC_LEGAL_CACHE_HITS);
+                return it->second;
+            }
+
+            count_metric(METRIC_LEGAL_CACHE_MISSES);
+            if (legal_cache.size() >= LEGAL_CACHE_SIZE) { legal_cache.clear(); }
+            PackedMove list[MAX_MOVES];
+            int count = getPosition().generate_moves(list);
+            vector<PackedMove>& legal = legal_cache[key];
+            legal.assign(list, list + count);
+            return legal;
+        }
+
+        // Checks if the side to move has a valid move on the board, which fills the legal moves of the ply
+        bool valid_moves() { return !legal_moves().empty(); }
+
+        // check the board current state, for the side to move
         void check_board_state() {
-            bool check = is_check(black_king);
-            bool valid_move = valid_moves(BLACK);
-            if (check && valid_move) {
-                state = BLACK_CHECK;
+            bool check;
+            bool valid_move = valid_moves();
+            if (valid_move && (rules.halfmove_clock >= 100 || repetitions() >= 2)) { // Fifty moves or threefold repetition
+                state = TIE;
                 return;
             }
-            else if (check && !valid_move) {
-                state = BLACK_CHECKMATE;
+            if (turn == BLACK) {
+                check = is_check(black_king);
+                if (check && valid_move) {
+                    state = BLACK_CHECK;
+                    return;
+                }
+                else if (check && !valid_move) {
+                    state = BLACK_CHECKMATE;
+                    return;
+                }
+                else if (!check && !valid_move) {
+                    state = TIE;
+                    return;
+                } 
+                state = NEUTRAL;
                 return;
             }
-            else if (!check && !valid_move) {
-                state = TIE;
-                return;
-            } 
         
             check = is_check(white_king);
-            valid_move = valid_moves(WHITE);
             if (check && valid_move) {
                 state = WHITE_CHECK;
                 return;
@@ -0,0 +1,127 @@
+// Implementation of the C interface in chesscore.h on top of the SDL free rules in position.cpp.
+// This file is compiled on its own into the chesscore library, it isn't included into main.cpp.
+
+#define CHESSCORE_BUILD
+#include <chesscore.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <position.cpp>
+
+using namespace std;
+
+static_assert(sizeof(chesscore_position) == 72, "chesscore_position must not have padding");
+static_assert(CHESSCORE_WHITE == WHITE && CHESSCORE_BLACK == BLACK, "colors must match the rules");
+static_assert(CHESSCORE_MAX_MOVES == MAX_MOVES, "move buffers must match the rules");
+
+#define CHESSCORE_HISTORY_PLIES 256 // Reserved for the moves made by perft, so deep counts don't allocate either
+
+// Every thread loads the positions of a batch into its own position, which keeps its memory between calls
+static Position& scratch_position() {
+    thread_local Position position;
+    thread_local bool reserved = false;
+    if (!reserved) {
+        position.history.reserve(CHESSCORE_HISTORY_PLIES);
+        reserved = true;
+    }
+    return position;
+}
+
+static bool load_position(const chesscore_position& in, Position& position) {
+    if (in.side > 1 || in.reserved != 0) { return false; }
+    return position.load(in.squares, (Color)in.side, in.castling, in.en_passant, in.halfmove_clock, in.fullmove);
+}
+
+static void store_position(const Position& position, chesscore_position& out) {
+    memcpy(out.squares, position.squares, sizeof(out.squares));
+    out.side = position.turn;
+    out.castling = position.castling;
+    out.en_passant = position.en_passant;
+    out.reserved = 0;
+    out.halfmove_clock = position.halfmove_clock;
+    out.fullmove = position.fullmove;
+}
+
+uint32_t chesscore_abi_version(void) { return CHESSCORE_ABI_VERSION; }
+
+size_t chesscore_from_fen(const char* const* fens, size_t count, chesscore_position* positions) {
+    Position& position = scratch_position();
+    size_t read = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (fens[i] != NULL && position.load_fen(fens[i])) {
+            store_position(position, positions[i]);
+            read++;
+        }
+        else { memset(&positions[i], 0, sizeof(chesscore_position)); }
+    }
+    return read;
+}
+
+size_t chesscore_to_fen(const chesscore_position* position, char* buffer, size_t size) {
+    Position& loaded = scratch_position();
+    if (!load_position(*position, loaded)) { return 0; }
+    string fen = loaded.fen();
+    if (fen.length() >= size) { return 0; }
+    memcpy(buffer, fen.c_str(), fen.length() + 1);
+    return fen.length();
+}
+
+void chesscore_status(const chesscore_position* positions, size_t count, uint8_t* statuses) {
+    Position& position = scratch_position();
+    for (size_t i = 0; i < count; i++) {
+        if (!load_position(positions[i], position)) {
+            statuses[i] = CHESSCORE_INVALID;
+            continue;
+        }
+        bool check = position.in_check();
+        // A mate on the move that reaches the fifty move limit still wins, as on the board
+        if (!position.has_legal_move()) { statuses[i] = check ? CHESSCORE_CHECKMATE : CHESSCORE_STALEMATE; }
+        else if (position.halfmove_clock >= 100) { statuses[i] = CHESSCORE_FIFTY_MOVES; }
+        else { statuses[i] = check ? CHESSCORE_CHECK : CHESSCORE_NORMAL; }
+    }
+}
+
+size_t chesscore_legal_moves(const chesscore_position* positions, size_t count, uint16_t* moves, size_t capacity,
+                             uint32_t* offsets) {
+    Position& position = scratch_position();
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        offsets[i] = (uint32_t)total;
+        if (!load_position(positions[i], position)) { continue; }
+        PackedMove list[MAX_MOVES];
+        int found = position.generate_moves(list);
+        if (total < capacity) { memcpy(moves + total, list, min((size_t)found, capacity - total) * sizeof(PackedMove)); }
+        total += found;
+    }
+    offsets[count] = (uint32_t)total;
+    return total;
+}
+
+size_t chesscore_play(const chesscore_position* positions, const uint16_t* moves, size_t count,
+                      chesscore_position* results) {
+    Position& position = scratch_position();
+    size_t played = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (load_position(positions[i], position)) {
+            PackedMove list[MAX_MOVES];
+            int found = position.generate_moves(list);
+            if (find(list, list + found, moves[i]) != list + found) {
+                Undo undo;
+                position.do_move(moves[i], undo);
+                store_position(position, results[i]);
+                played++;
+                continue;
+            }
+        }
+        if (&results[i] != &positions[i]) { results[i] = positions[i]; }
+    }
+    return played;
+}
+
+void chesscore_perft(const chesscore_position* positions, size_t count, uint32_t depth, uint64_t* nodes) {
+    Position& position = scratch_position();
+    for (size_t i = 0; i < count; i++) {
+        nodes[i] = load_position(positions[i], position) ? position.perft(depth) : 0;
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef CHESSCORE_H
+#define CHESSCORE_H
+
+/*
+ * C interface of the chess rules, built as the chesscore library.
+ *
+ * Every call takes an array of positions and writes its results into buffers the caller provides, so a caller
+ * from another language crosses the boundary once per batch. Apart from the FEN conversions the calls don't
+ * allocate memory. They may be made from several threads at once and keep no state between calls.
+ *
+ * Squares are numbered 0 (a1) to 63 (h8), rank by rank. A piece is its type (1 pawn, 2 knight, 3 bishop,
+ * 4 rook, 5 queen, 6 king) plus 8 for white, 0 is an empty square. A move is 16 bits: the from square in bits
+ * 0-5, the to square in bits 6-11 and the promotion piece type in bits 12-14. Castling is the king move of two
+ * files.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(CHESSCORE_SHARED)
+#  ifdef CHESSCORE_BUILD
+#    define CHESSCORE_API __declspec(dllexport)
+#  else
+#    define CHESSCORE_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__)
+#  define CHESSCORE_API __attribute__((visibility("default")))
+#else
+#  define CHESSCORE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Changes whenever a struct layout or a call changes incompatibly */
+#define CHESSCORE_ABI_VERSION 1
+
+#define CHESSCORE_WHITE 1
+#define CHESSCORE_BLACK 0
+#define CHESSCORE_NO_SQUARE (-1)
+#define CHESSCORE_MAX_MOVES 256 /* Enough for the legal moves of any valid position */
+
+/* Castling rights */
+#define CHESSCORE_WHITE_KING_SIDE 1
+#define CHESSCORE_WHITE_QUEEN_SIDE 2
+#define CHESSCORE_BLACK_KING_SIDE 4
+#define CHESSCORE_BLACK_QUEEN_SIDE 8
+
+/* 72 bytes, without padding, so it can be mapped directly from arrays of other languages */
+typedef struct chesscore_position {
+    uint8_t squares[64];
+    uint8_t side; /* Side to move */
+    uint8_t castling;
+    int8_t en_passant; /* Square behind a pawn that just moved two ranks, or CHESSCORE_NO_SQUARE */
+    uint8_t reserved; /* Must be 0 */
+    uint16_t halfmove_clock; /* Plies since the last capture or pawn move */
+    uint16_t fullmove;
+} chesscore_position;
+
+/* State of a position for the side to move */
+enum chesscore_status {
+    CHESSCORE_NORMAL = 0,
+    CHESSCORE_CHECK = 1,
+    CHESSCORE_CHECKMATE = 2,
+    CHESSCORE_STALEMATE = 3,
+    CHESSCORE_FIFTY_MOVES = 4, /* Drawn by the fifty move rule, repetitions can't be seen without the game */
+    CHESSCORE_INVALID = 255 /* A square holds no valid piece, a side hasn't exactly one king, more than 16 pieces or
+                               more than 8 pawns, or a pawn stands on the first or last rank */
+};
+
+/* CHESSCORE_ABI_VERSION of the library, to compare with the one of this header */
+CHESSCORE_API uint32_t chesscore_abi_version(void);
+
+/*
+ * Reads FEN strings, or the first four fields of EPD lines. A string that can't be read leaves an invalid
+ * position with all squares empty. Returns the number of positions read.
+ */
+CHESSCORE_API size_t chesscore_from_fen(const char* const* fens, size_t count, chesscore_position* positions);
+
+/* Writes a position as a FEN string, returns its length without the terminating zero or 0 if it doesn't fit */
+CHESSCORE_API size_t chesscore_to_fen(const chesscore_position* position, char* buffer, size_t size);
+
+/* Writes the state of every position into statuses, one enum chesscore_status per position */
+CHESSCORE_API void chesscore_status(const chesscore_position* positions, size_t count, uint8_t* statuses);
+
+/*
+ * Writes the legal moves of all positions one after another into moves. The moves of position i are
+ * moves[offsets[i]] to moves[offsets[i + 1] - 1], so offsets holds count + 1 entries. An invalid position has
+ * no moves. Returns the total number of moves. When it is larger than capacity, only the moves that fit were
+ * written, and the call can be repeated with a larger buffer; count * CHESSCORE_MAX_MOVES always suffices.
+ */
+CHESSCORE_API size_t chesscore_legal_moves(const chesscore_position* positions, size_t count, uint16_t* moves,
+                                           size_t capacity, uint32_t* offsets);
+
+/*
+ * Plays one move in every position, writing the positions after them into results, which may be the same
+ * array as positions. Returns the number of moves that were legal, a position with an illegal move is copied.
+ */
+CHESSCORE_API size_t chesscore_play(const chesscore_position* positions, const uint16_t* moves, size_t count,
+                                    chesscore_position* results);
+
+/* Counts the leaf nodes of the legal move tree of every position to the given depth, 0 for invalid ones */
+CHESSCORE_API void chesscore_perft(const chesscore_position* positions, size_t count, uint32_t depth,
+                                   uint64_t* nodes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+#include <types.h>
+
+using namespace std;
+
+#define CLOCK_MOVE_OVERHEAD_US 30000 // Kept back by allocate() for the time between deciding and pressing the clock
+#define CLOCK_MOVES_TO_GO 30 // Moves the remaining time is planned for when the period doesn't say
+
+// Time of the virtual clock while a recorded session is replayed, negative while the real clock runs.
+// The replay advances it by one frame time per frame, so the game sees the same times in every replay.
+inline atomic<int64_t>& clock_virtual_us() {
+    static atomic<int64_t> time(-1);
+    return time;
+}
+
+// Microseconds from the monotonic clock, which is not affected by changes of the system time
+inline int64_t clock_now_us() {
+    int64_t virtual_time = clock_virtual_us().load(memory_order_relaxed);
+    if (virtual_time >= 0) { return virtual_time; }
+    static auto origin = chrono::steady_clock::now();
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - origin).count();
+}
+
+typedef struct {
+    int64_t base_us; // Time for the game, or for every period of moves
+    int64_t increment_us; // Added after every move
+    int moves_per_period; // Moves until the base time is added again, 0 for the whole game
+    int64_t delay_us; // Bronstein delay, time used for a move is given back up to this amount
+} TimeControl;
+
+// Parses a time control in seconds, written as [moves/]base[+increment][d delay], e.g. "300+2", "40/5400+30" or "180d2".
+// Returns false if it can't be parsed.
+inline bool parse_time_control(string text, TimeControl& control) {
+    control = { 0, 0, 0, 0 };
+    const char* c = text.c_str();
+    char* end;
+    size_t slash = text.find('/');
+    if (slash != string::npos) {
+        control.moves_per_period = strtol(c, &end, 10);
+        if (end != c + slash || control.moves_per_period <= 0) { return false; }
+        c = end + 1;
+    }
+    double base = strtod(c, &end);
+    if (end == c || base <= 0) { return false; }
+    control.base_us = base * 1e6;
+    c = end;
+    if (*c == '+') {
+        double increment = strtod(c + 1, &end);
+        if (end == c + 1 || increment < 0) { return false; }
+        control.increment_us = increment * 1e6;
+        c = end;
+    }
+    if (*c == 'd') {
+        double delay = strtod(c + 1, &end);
+        if (end == c + 1 || delay < 0) { return false; }
+        control.delay_us = delay * 1e6;
+        c = end;
+    }
+    return *c == '\0';
+}
+
+// Time a player should spend on a move, and the most it may spend before it risks the game
+typedef struct {
+    int64_t optimum_us;
+    int64_t maximum_us;
+} TimeBudget;
+
+// Clocks of both players. All times are passed in from clock_now_us(), so a press can be dated back
+// to the moment the input happened instead of the moment it was processed.
+class ChessClock {
+    private:
+        TimeControl control;
+        int64_t remaining[2];
+        int period_moves[2]; // Moves made in the current period
+        Color running_side;
+        bool running;
+        bool flagged;
+        int64_t turn_start;
+
+    public:
+        ChessClock(TimeControl control = { 600000000, 0, 0, 0 }) { reset(control); }
+
+        void reset(TimeControl control) {
+            this->control = control;
+            remaining[WHITE] = remaining[BLACK] = control.base_us;
+            period_moves[WHITE] = period_moves[BLACK] = 0;
+            running_side = WHITE;
+            running = false;
+            flagged = false;
+            turn_start = 0;
+        }
+
+        TimeControl getControl() { return control; }
+        bool is_running() { return running; }
+        bool is_flagged() { return flagged; }
+        Color getRunningSide() { return running_side; } // Also the side that flagged
+
+        // Starts the clock of the given side
+        void start(Color side, int64_t now) {
+            if (flagged) { return; }
+            running_side = side;
+            running = true;
+            turn_start = now;
+        }
+
+        // Stops the running clock without finishing the move, like at the end of the game
+        void stop(int64_t now) {
+            if (!running) { return; }
+            remaining[running_side] = max((int64_t)0, remaining[running_side] - (now - turn_start));
+            running = false;
+        }
+
+        // Finishes the move of the running side at the given time and starts the clock of the other side.
+        // Returns false if the time had already run out at that moment, then the side has flagged.
+        bool press(int64_t now) {
+            if (!running) { return !flagged; }
+            int64_t used = max((int64_t)0, now - turn_start);
+            if (remaining[running_side] - used <= 0) {
+                remaining[running_side] = 0;
+                running = false;
+                flagged = true;
+                return false;
+            }
+            remaining[running_side] += min(used, control.delay_us) - used + control.increment_us;
+            if (control.moves_per_period > 0 && ++period_moves[running_side] == control.moves_per_period) {
+                remaining[running_side] += control.base_us;
+                period_moves[running_side] = 0;
+            }
+            running_side = (Color)!running_side;
+            turn_start = now;
+            return true;
+        }
+
+        // Flags the running side if its time has run out, returns true if a side has flagged
+        bool flag(int64_t now) {
+            if (running && remaining[running_side] - (now - turn_start) <= 0) {
+                remaining[running_side] = 0;
+                running = false;
+                flagged = true;
+            }
+            return flagged;
+        }
+
+        int64_t time_left(Color side, int64_t now) {
+            if (!running || side != running_side) { return remaining[side]; }
+            return max((int64_t)0, remaining[side] - (now - turn_start));
+        }
+
+        // Moves left until the next time control, or a planning horizon for sudden death
+        int moves_to_go(Color side) {
+            if (control.moves_per_period > 0) { return control.moves_per_period - period_moves[side]; }
+            return CLOCK_MOVES_TO_GO;
+        }
+
+        // Budget for the current move of the given side. The remaining time is spread over the moves to go,
+        // plus most of the increment and the full delay, which is given back anyway. The overhead for
+        // reacting and pressing the clock is always kept back, but never more than a twentieth of the time.
+        TimeBudget allocate(Color side, int64_t now, int64_t overhead_us = CLOCK_MOVE_OVERHEAD_US) {
+            int64_t left = time_left(side, now);
+            int64_t usable = max((int64_t)0, left - min(overhead_us, left / 20));
+            int moves = max(1, moves_to_go(side));
+            int64_t optimum = usable / moves + control.increment_us * 3 / 4 + control.delay_us;
+            int64_t maximum = moves == 1 ? usable : min(usable / 2, optimum * 5);
+            optimum = min(optimum, usable);
+            maximum = min(max(maximum, optimum), usable);
+            return { optimum, maximum };
+        }
+};
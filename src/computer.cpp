@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <search.cpp>
+#include <clock.cpp>
+
+using namespace std;
+
+#define COMPUTER_HASH_MB 64
+#define COMPUTER_MOVE_MS 1000 // Time for a move when the game is played without a clock
+
+// Plays one side of the game, searching on a background thread so the window keeps running.
+// With pondering it keeps searching after its move, on the position after the reply it expects. If the opponent
+// plays that reply, the running search becomes the search for the next move, and the time already spent counts
+// towards it, so the move is often ready at once. Otherwise the search is stopped, and the new one still finds
+// the positions searched so far in the transposition table.
+class ComputerPlayer {
+    private:
+        TranspositionTable tt;
+        Search search;
+        thread worker;
+        mutex lock;
+        condition_variable wake;
+        Position job;
+        SearchLimits job_limits;
+        uint64_t job_key = 0; // Position of the latest job, waiting or running
+        int job_id = 0; // Counts the jobs, so the result of a replaced job is dropped
+        bool has_job = false;
+        bool running = false;
+        int64_t run_start_us = 0;
+        bool quit = false;
+        bool pondering = false; // The latest job searches the expected reply of the opponent
+        PackedMove ponder_move = NULL_MOVE; // The expected reply
+        bool wanted = false; // The owner waits for a move from the latest job
+        bool result_ready = false;
+        vector<SearchLine> result;
+
+        void loop() {
+            unique_lock<mutex> guard(lock);
+            while (true) {
+                wake.wait(guard, [this] { return has_job || quit; });
+                if (quit) { return; }
+                Position position = job;
+                SearchLimits limits = job_limits;
+                int id = job_id;
+                has_job = false;
+                running = true;
+                run_start_us = clock_now_us();
+                search.stop = false;
+                if (limits.ponder) { search.set_deadline(0); }
+                guard.unlock();
+
+                vector<SearchLine> lines = search.run(position, limits);
+
+                guard.lock();
+                running = false;
+                if (id == job_id) {
+                    result = lines;
+                    result_ready = true;
+                }
+            }
+        }
+
+        // Replaces the latest job, the caller holds the lock
+        void set_job(const Position& position, SearchLimits limits) {
+            job = position;
+            job_limits = limits;
+            job_key = position.key;
+            job_id++;
+            has_job = true;
+            result_ready = false;
+            if (running) { search.stop = true; }
+            wake.notify_one();
+        }
+
+    public:
+        ComputerPlayer() : tt(COMPUTER_HASH_MB), search(tt) {}
+        ~ComputerPlayer() { stop(); }
+
+        bool is_running() { return worker.joinable(); }
+
+        void start() {
+            if (is_running()) { return; }
+            quit = false;
+            worker = thread(&ComputerPlayer::loop, this);
+        }
+
+        void stop() {
+            if (!is_running()) { return; }
+            {
+                lock_guard<mutex> guard(lock);
+                quit = true;
+                search.stop = true;
+            }
+            wake.notify_one();
+            worker.join();
+        }
+
+        // Drops the current search and its result, like when a new game starts
+        void cancel() {
+            lock_guard<mutex> guard(lock);
+            job_id++;
+            job_key = 0;
+            has_job = false;
+            pondering = false;
+            wanted = false;
+            result_ready = false;
+            if (running) { search.stop = true; }
+        }
+
+        // Starts searching a move for the position with the given time. If it is the position being pondered,
+        // the ponder search continues with the time left after what it has already used.
+        void think(const Position& position, int time_ms) {
+            lock_guard<mutex> guard(lock);
+            wanted = true;
+            if (pondering && position.key == job_key) {
+                pondering = false;
+                if (has_job) { // Not started yet, becomes a normal search
+                    job_limits.ponder = false;
+                    job_limits.time_ms = time_ms;
+                }
+                else if (running) { search.set_deadline(run_start_us + time_ms * 1000LL); }
+                return; // Or it has already finished, with a mate or at the maximum depth
+            }
+            pondering = false;
+            set_job(position, { 0, 1, 0, time_ms, false });
+        }
+
+        // Starts pondering on the position after the own move, if the last search expects a reply
+        void ponder(const Position& position) {
+            lock_guard<mutex> guard(lock);
+            if (result.empty() || result[0].pv.size() < 2) { return; }
+            PackedMove reply = result[0].pv[1];
+            Position after = position;
+            if (!after.is_pseudo_legal(reply) || !after.is_legal(reply)) { return; }
+            Undo undo;
+            after.do_move(reply, undo);
+            pondering = true;
+            ponder_move = reply;
+            wanted = false;
+            set_job(after, { 0, 1, 0, 0, true });
+        }
+
+        // Returns true once the move asked for with think() is found
+        bool poll(PackedMove& move) {
+            lock_guard<mutex> guard(lock);
+            if (!wanted || !result_ready || result.empty()) { return false; }
+            move = result[0].pv[0];
+            wanted = false;
+            return true;
+        }
+
+        // The reply the computer is pondering on, NULL_MOVE if it isn't pondering
+        PackedMove getPonderMove() {
+            lock_guard<mutex> guard(lock);
+            return pondering ? ponder_move : NULL_MOVE;
+        }
+};
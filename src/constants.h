@@ -2,6 +2,12 @@
 #define FONT_SIZE SIZE / 16
 #define FPS 120
 #define TIME 600000 //10 minutes in milliseconds
+#define AUDIO_FREQUENCY 44100 // Output sample rate, set explicitly since the mixer default is 22050 Hz before SDL_mixer 2.6
+#define AUDIO_BUFFER 256 // Audio buffer in sample frames, about 6ms at 44.1kHz
+#define AUDIO_CHANNELS 16 // Mixer channels, so sound effects can overlap
+#define ARCHIVE_PATH "games.chsa" // Game archive the played games are saved to
+#define METRICS_INTERVAL_MS 1000 // How often the metrics file and the metrics view are updated
+#define EXPORT_HOLD_FRAMES 60 // Frames an exported replay shows each position after its move, half a second at FPS
 // Below is used for testing and in the final windows version, where everything is in the same folder
 #define SRC_PATH "../"
 
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include <cstdio>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+using namespace std;
+
+#define ENCODER_QUEUE_FRAMES 4 // Frames waiting per encoder thread, more only takes memory
+
+// Pixels of a frame, 32 bit ARGB values row by row. Frames that show the same picture share one buffer.
+typedef shared_ptr<vector<uint32_t>> FramePixels;
+
+// Encodes the frames of a clip on worker threads, so the next frames are rendered while the last ones are written.
+// The frames are numbered PNG files in a folder, or one raw stream of 24 bit RGB pixels, which is written in
+// frame order and can be read by e.g. "ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -i FILE".
+class FrameEncoder {
+    private:
+        typedef struct {
+            int number;
+            FramePixels pixels;
+        } FrameJob;
+
+        int width = 0, height = 0;
+        string folder; // Empty when writing a stream
+        FILE* stream = NULL;
+        vector<thread> workers;
+        mutex lock;
+        condition_variable wake; // A job was added, or the encoder closes
+        condition_variable room; // A job was taken
+        deque<FrameJob> jobs;
+        size_t max_jobs = 0;
+        map<int, vector<uint8_t>> converted; // Stream frames finished before an earlier frame
+        int submitted = 0;
+        int next_write = 0;
+        bool closing = false;
+        bool failed = false;
+
+        bool write_png(const FrameJob& job) {
+            char name[32];
+            snprintf(name, sizeof(name), "frame_%06d.png", job.number);
+            SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(job.pixels->data(), width, height, 32,
+                width * 4, SDL_PIXELFORMAT_ARGB8888);
+            bool saved = surface != NULL && IMG_SavePNG(surface, (folder + name).c_str()) == 0;
+            SDL_FreeSurface(surface);
+            return saved;
+        }
+
+        vector<uint8_t> to_rgb(const vector<uint32_t>& pixels) {
+            vector<uint8_t> rgb(pixels.size() * 3);
+            for (size_t i = 0; i < pixels.size(); i++) {
+                rgb[3 * i] = pixels[i] >> 16;
+                rgb[3 * i + 1] = pixels[i] >> 8;
+                rgb[3 * i + 2] = pixels[i];
+            }
+            return rgb;
+        }
+
+        // Writes the converted frames that are next in order, the caller holds the lock
+        void write_stream() {
+            for (auto it = converted.find(next_write); it != converted.end(); it = converted.find(next_write)) {
+                if (fwrite(it->second.data(), 1, it->second.size(), stream) != it->second.size()) { failed = true; }
+                converted.erase(it);
+                next_write++;
+            }
+        }
+
+        void loop() {
+            unique_lock<mutex> guard(lock);
+            while (true) {
+                wake.wait(guard, [this] { return !jobs.empty() || closing; });
+                if (jobs.empty()) { return; }
+                FrameJob job = jobs.front();
+                jobs.pop_front();
+                room.notify_one();
+                guard.unlock();
+
+                bool saved = true;
+                vector<uint8_t> rgb;
+                if (stream == NULL) { saved = write_png(job); }
+                else { rgb = to_rgb(*job.pixels); }
+
+                guard.lock();
+                if (!saved) { failed = true; }
+                if (stream != NULL) {
+                    converted[job.number] = std::move(rgb);
+                    write_stream();
+                }
+            }
+        }
+
+        void start(int w, int h, int threads) {
+            width = w;
+            height = h;
+            submitted = 0;
+            next_write = 0;
+            closing = false;
+            failed = false;
+            threads = max(1, threads);
+            max_jobs = threads * ENCODER_QUEUE_FRAMES;
+            for (int i = 0; i < threads; i++) { workers.emplace_back(&FrameEncoder::loop, this); }
+        }
+
+    public:
+        ~FrameEncoder() { finish(); }
+
+        // Writes the frames as folder/frame_000000.png and so on, the folder is created if needed
+        bool open_frames(string path, int w, int h, int threads) {
+            finish();
+            error_code error;
+            filesystem::create_directories(path, error);
+            if (!filesystem::is_directory(path)) {
+                cout << "Cannot create folder: " << path << endl;
+                return false;
+            }
+            folder = path.back() == '/' ? path : path + "/";
+            start(w, h, threads);
+            return true;
+        }
+
+        // Writes the frames to one raw file, or to the standard output for "-"
+        bool open_stream(string path, int w, int h, int threads) {
+            finish();
+            stream = path == "-" ? stdout : fopen(path.c_str(), "wb");
+            if (stream == NULL) {
+                cout << "Cannot write: " << path << endl;
+                return false;
+            }
+            folder.clear();
+            start(w, h, threads);
+            return true;
+        }
+
+        // Queues the next frame, waits while the workers are too far behind
+        void submit(FramePixels pixels) {
+            unique_lock<mutex> guard(lock);
+            room.wait(guard, [this] { return jobs.size() < max_jobs; });
+            jobs.push_back({ submitted++, pixels });
+            wake.notify_one();
+        }
+
+        // Waits until every frame is written, returns false if one of them couldn't be
+        bool finish() {
+            if (workers.empty()) { return !failed; }
+            {
+                lock_guard<mutex> guard(lock);
+                closing = true;
+            }
+            wake.notify_all();
+            for (auto& w : workers) { w.join(); }
+            workers.clear();
+            if (stream != NULL) {
+                if (fflush(stream) != 0) { failed = true; }
+                if (stream != stdout) { fclose(stream); }
+                stream = NULL;
+            }
+            return !failed;
+        }
+
+        int getFrames() { return submitted; }
+};
@@ -1,10 +1,14 @@
+#pragma once
+
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 
+#include <assets.cpp>
 #include <constants.h>
 
 using namespace std;
@@ -25,21 +29,43 @@ class Entity {
         }
 
         void render(SDL_Renderer* renderer) {
-            SDL_Surface* surface = NULL;
-            SDL_Texture* texture = NULL;
-            surface = IMG_Load(&path[0]);
-
-            if (surface == NULL) {
-                cout << "Cannot find: " << &path[0] << endl;
-                SDL_Quit();
-                exit(1);
+            SDL_Rect rect = { x, y, w, h };
+            SDL_RenderCopyEx(renderer, getTexture(renderer, path), NULL, &rect, 0, NULL, SDL_FLIP_NONE);
+        }
+
+        // Returns the texture for the given image, which is only loaded the first time it is used with a renderer
+        static SDL_Texture* getTexture(SDL_Renderer* renderer, string path) {
+            auto& texture = textures()[{ renderer, path }];
+            if (texture == NULL) {
+                SDL_Surface* surface = assets().load_image(path);
+
+                if (surface == NULL) {
+                    cout << "Cannot find: " << &path[0] << endl;
+                    SDL_Quit();
+                    exit(1);
+                }
+
+                texture = SDL_CreateTextureFromSurface(renderer, surface);
+                SDL_FreeSurface(surface);
             }
+            return texture;
+        }
 
-            texture = SDL_CreateTextureFromSurface(renderer, surface);
-            SDL_FreeSurface(surface);
+        // Destroys all textures loaded for the given renderer, called before the renderer is destroyed
+        static void releaseTextures(SDL_Renderer* renderer) {
+            auto& cache = textures();
+            for (auto it = cache.begin(); it != cache.end();) {
+                if (it->first.first == renderer) {
+                    SDL_DestroyTexture(it->second);
+                    it = cache.erase(it);
+                }
+                else { it++; }
+            }
+        }
 
-            SDL_Rect rect = { x, y, w, h };
-            SDL_RenderCopyEx(renderer, texture, NULL, &rect, 0, NULL, SDL_FLIP_NONE);
-            SDL_DestroyTexture(texture);
+    private:
+        static map<pair<SDL_Renderer*, string>, SDL_Texture*>& textures() {
+            static map<pair<SDL_Renderer*, string>, SDL_Texture*> cache;
+            return cache;
         }
 };
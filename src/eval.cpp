@@ -0,0 +1,78 @@
+#pragma once
+
+#include <iostream>
+
+#include <position.cpp>
+
+using namespace std;
+
+// Static evaluation in centipawns, from the view of the side to move.
+// Material and piece-square values are given for the middlegame and the endgame, and blended by the
+// material left on the board.
+
+#define MG 0
+#define EG 1
+#define PHASE_MAX 24 // Phase with all pieces on the board, knights and bishops count 1, rooks 2 and queens 4
+
+// All tunable values are kept in one flat table, so the tuner can treat them as a single vector:
+//   piece values      [phase][type]            at EVAL_VALUES
+//   piece-square      [phase][type][index]     at EVAL_PIECE_SQUARE
+// Piece-square tables are written from white's side with rank 8 first, a white piece on square s
+// uses index s ^ 56 and a black piece index s. Type 0 (no piece) is always 0.
+#define EVAL_TYPES 7
+#define EVAL_VALUES 0
+#define EVAL_PIECE_SQUARE (EVAL_VALUES + 2 * EVAL_TYPES)
+#define EVAL_PARAMS (EVAL_PIECE_SQUARE + 2 * EVAL_TYPES * 64)
+
+inline int value_param(int phase, int type) { return EVAL_VALUES + phase * EVAL_TYPES + type; }
+inline int square_param(int phase, int type, int index) { return EVAL_PIECE_SQUARE + (phase * EVAL_TYPES + type) * 64 + index; }
+
+// Index into a piece-square table for a piece of the given color
+inline int square_index(int square, Color color) { return color == WHITE ? square ^ 56 : square; }
+
+int eval_params[EVAL_PARAMS] = {
+#include <eval_params.h>
+};
+
+static const int piece_phase[7] = { 0, 0, 1, 1, 2, 4, 0 };
+
+// Writes the parameters in the format of eval_params.h
+inline void write_eval_params(ostream& out, const int* params) {
+    const char* phases[2] = { "middlegame", "endgame" };
+    const char* names[EVAL_TYPES] = { "No piece, always 0", "Pawn", "Knight", "Bishop", "Rook", "Queen", "King" };
+    out << "// Evaluation parameters in the layout of eval_params (src/eval.cpp), written by chess-tune\n";
+    for (int phase = MG; phase <= EG; phase++) {
+        out << "// Piece values, " << phases[phase] << "\n";
+        for (int type = 0; type < EVAL_TYPES; type++) {
+            out << params[value_param(phase, type)] << (type + 1 < EVAL_TYPES ? ", " : ",\n");
+        }
+    }
+    char number[16];
+    for (int phase = MG; phase <= EG; phase++) {
+        for (int type = 0; type < EVAL_TYPES; type++) {
+            out << "// " << names[type] << ", " << phases[phase] << "\n";
+            for (int i = 0; i < 64; i++) {
+                snprintf(number, sizeof(number), "%4d,", params[square_param(phase, type, i)]);
+                out << number << (i % 8 == 7 ? "\n" : " ");
+            }
+        }
+    }
+}
+
+inline int evaluate(Position& position) {
+    int score[2] = { 0, 0 };
+    int phase = 0;
+    for (int s = 0; s < 64; s++) {
+        uint8_t piece = position.squares[s];
+        if (piece == 0) { continue; }
+        PieceType type = piece_type(piece);
+        int index = square_index(s, piece_color(piece));
+        int sign = piece_color(piece) == WHITE ? 1 : -1;
+        score[MG] += sign * (eval_params[value_param(MG, type)] + eval_params[square_param(MG, type, index)]);
+        score[EG] += sign * (eval_params[value_param(EG, type)] + eval_params[square_param(EG, type, index)]);
+        phase += piece_phase[type];
+    }
+    phase = min(phase, PHASE_MAX);
+    int blended = (score[MG] * phase + score[EG] * (PHASE_MAX - phase)) / PHASE_MAX;
+    return position.turn == WHITE ? blended : -blended;
+}
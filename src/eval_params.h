@@ -0,0 +1,131 @@
+// Evaluation parameters in the layout of eval_params (src/eval.cpp), written by chess-tune
+// Piece values, middlegame
+0, 82, 337, 365, 477, 1025, 0,
+// Piece values, endgame
+0, 94, 281, 297, 512, 936, 0,
+// No piece, always 0, middlegame
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+// Pawn, middlegame
+   0,    0,    0,    0,    0,    0,    0,    0,
+  50,   50,   50,   50,   50,   50,   50,   50,
+  10,   10,   20,   30,   30,   20,   10,   10,
+   5,    5,   10,   25,   25,   10,    5,    5,
+   0,    0,    0,   20,   20,    0,    0,    0,
+   5,   -5,  -10,    0,    0,  -10,   -5,    5,
+   5,   10,   10,  -20,  -20,   10,   10,    5,
+   0,    0,    0,    0,    0,    0,    0,    0,
+// Knight, middlegame
+ -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+ -40,  -20,    0,    0,    0,    0,  -20,  -40,
+ -30,    0,   10,   15,   15,   10,    0,  -30,
+ -30,    5,   15,   20,   20,   15,    5,  -30,
+ -30,    0,   15,   20,   20,   15,    0,  -30,
+ -30,    5,   10,   15,   15,   10,    5,  -30,
+ -40,  -20,    0,    5,    5,    0,  -20,  -40,
+ -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+// Bishop, middlegame
+ -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+ -10,    0,    0,    0,    0,    0,    0,  -10,
+ -10,    0,    5,   10,   10,    5,    0,  -10,
+ -10,    5,    5,   10,   10,    5,    5,  -10,
+ -10,    0,   10,   10,   10,   10,    0,  -10,
+ -10,   10,   10,   10,   10,   10,   10,  -10,
+ -10,    5,    0,    0,    0,    0,    5,  -10,
+ -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+// Rook, middlegame
+   0,    0,    0,    0,    0,    0,    0,    0,
+   5,   10,   10,   10,   10,   10,   10,    5,
+  -5,    0,    0,    0,    0,    0,    0,   -5,
+  -5,    0,    0,    0,    0,    0,    0,   -5,
+  -5,    0,    0,    0,    0,    0,    0,   -5,
+  -5,    0,    0,    0,    0,    0,    0,   -5,
+  -5,    0,    0,    0,    0,    0,    0,   -5,
+   0,    0,    0,    5,    5,    0,    0,    0,
+// Queen, middlegame
+ -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+ -10,    0,    0,    0,    0,    0,    0,  -10,
+ -10,    0,    5,    5,    5,    5,    0,  -10,
+  -5,    0,    5,    5,    5,    5,    0,   -5,
+   0,    0,    5,    5,    5,    5,    0,   -5,
+ -10,    5,    5,    5,    5,    5,    0,  -10,
+ -10,    0,    5,    0,    0,    0,    0,  -10,
+ -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+// King, middlegame
+ -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+ -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+ -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+ -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+ -20,  -30,  -30,  -40,  -40,  -30,  -30,  -20,
+ -10,  -20,  -20,  -20,  -20,  -20,  -20,  -10,
+  20,   20,    0,    0,    0,    0,   20,   20,
+  20,   30,   10,    0,    0,   10,   30,   20,
+// No piece, always 0, endgame
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+// Pawn, endgame
+   0,    0,    0,    0,    0,    0,    0,    0,
+  80,   80,   80,   80,   80,   80,   80,   80,
+  50,   50,   50,   50,   50,   50,   50,   50,
+  30,   30,   30,   30,   30,   30,   30,   30,
+  20,   20,   20,   20,   20,   20,   20,   20,
+  10,   10,   10,   10,   10,   10,   10,   10,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+// Knight, endgame
+ -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+ -40,  -20,    0,    0,    0,    0,  -20,  -40,
+ -30,    0,   10,   15,   15,   10,    0,  -30,
+ -30,    5,   15,   20,   20,   15,    5,  -30,
+ -30,    0,   15,   20,   20,   15,    0,  -30,
+ -30,    5,   10,   15,   15,   10,    5,  -30,
+ -40,  -20,    0,    5,    5,    0,  -20,  -40,
+ -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+// Bishop, endgame
+ -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+ -10,    0,    0,    0,    0,    0,    0,  -10,
+ -10,    0,    5,   10,   10,    5,    0,  -10,
+ -10,    5,    5,   10,   10,    5,    5,  -10,
+ -10,    0,   10,   10,   10,   10,    0,  -10,
+ -10,   10,   10,   10,   10,   10,   10,  -10,
+ -10,    5,    0,    0,    0,    0,    5,  -10,
+ -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+// Rook, endgame
+   0,    0,    0,    0,    0,    0,    0,    0,
+   5,   10,   10,   10,   10,   10,   10,    5,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+   0,    0,    0,    0,    0,    0,    0,    0,
+// Queen, endgame
+ -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+ -10,    0,    0,    0,    0,    0,    0,  -10,
+ -10,    0,    5,    5,    5,    5,    0,  -10,
+  -5,    0,    5,    5,    5,    5,    0,   -5,
+  -5,    0,    5,    5,    5,    5,    0,   -5,
+ -10,    0,    5,    5,    5,    5,    0,  -10,
+ -10,    0,    0,    0,    0,    0,    0,  -10,
+ -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+// King, endgame
+ -50,  -40,  -30,  -20,  -20,  -30,  -40,  -50,
+ -30,  -20,  -10,    0,    0,  -10,  -20,  -30,
+ -30,  -10,   20,   30,   30,   20,  -10,  -30,
+ -30,  -10,   30,   40,   40,   30,  -10,  -30,
+ -30,  -10,   30,   40,   40,   30,  -10,  -30,
+ -30,  -10,   20,   30,   30,   20,  -10,  -30,
+ -30,  -30,    0,    0,    0,    0,  -30,  -30,
+ -50,  -30,  -30,  -30,  -30,  -30,  -30,  -50,
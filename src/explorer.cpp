@@ -0,0 +1,296 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+
+#include <archive.cpp>
+#include <mapped.cpp>
+
+using namespace std;
+
+// Opening explorer: how often each move was played in a position of the game collection, and how those games
+// ended. The index is a file of entries sorted by position key and move, which is mapped into memory, so a lookup
+// only touches the few pages of its position and the index never has to fit into memory.
+//
+// File layout, all numbers little endian and stored as they are in memory:
+//   header   ExplorerHeader
+//   buckets  2^bucket_bits + 1 entry numbers (u64), bucket b holds the keys whose top bits are b
+//   entries  ExplorerEntry for every move played in every position, sorted by key and move
+//
+// The index is built like an external sort. Every thread replays games of the archives and counts into its own
+// table. A full table is sorted and written to a run file, and the runs are merged into the index at the end.
+
+#define EXPLORER_VERSION 1
+#define EXPLORER_PATH "explorer.chox"
+#define EXPLORER_BUCKET_BITS 16
+#define EXPLORER_MAX_PLIES 40 // Only the openings of the games are indexed by default
+#define EXPLORER_MEMORY_MB 512 // For the tables of all threads together, before they're written as runs
+#define EXPLORER_TABLE_ENTRY_BYTES 64 // Memory of one counted move in a table, with the hash map's overhead
+
+typedef struct {
+    char magic[4]; // "CHOX"
+    uint32_t version;
+    uint32_t bucket_bits;
+    uint32_t reserved;
+    uint64_t entries;
+    uint64_t games;
+} ExplorerHeader;
+
+typedef struct {
+    uint64_t key; // Position::key before the move
+    PackedMove move;
+    uint16_t reserved;
+    uint32_t white_wins;
+    uint32_t draws;
+    uint32_t black_wins;
+} ExplorerEntry;
+
+static_assert(sizeof(ExplorerHeader) == 32 && sizeof(ExplorerEntry) == 24, "The index layout has to stay fixed");
+
+inline uint32_t explorer_games(const ExplorerEntry& entry) { return entry.white_wins + entry.draws + entry.black_wins; }
+
+inline bool explorer_less(const ExplorerEntry& a, const ExplorerEntry& b) {
+    return a.key != b.key ? a.key < b.key : a.move < b.move;
+}
+
+// Read only view of an index
+class OpeningExplorer {
+    private:
+        MappedFile file;
+        const ExplorerHeader* header = NULL;
+        const uint64_t* buckets = NULL;
+        const ExplorerEntry* entries = NULL;
+
+    public:
+        // Maps the index, returns false if it doesn't exist or isn't an index
+        bool open(string path) {
+            close();
+            if (!file.open(path, true)) { return false; }
+            size_t size = file.getSize();
+            header = (const ExplorerHeader*)file.getData();
+            bool valid = size >= sizeof(ExplorerHeader) && memcmp(header->magic, "CHOX", 4) == 0 &&
+                header->version == EXPLORER_VERSION && header->bucket_bits <= 24;
+            if (valid) {
+                uint64_t bucket_count = (1ULL << header->bucket_bits) + 1;
+                buckets = (const uint64_t*)(file.getData() + sizeof(ExplorerHeader));
+                entries = (const ExplorerEntry*)(buckets + bucket_count);
+                valid = sizeof(ExplorerHeader) + bucket_count * sizeof(uint64_t) + header->entries * sizeof(ExplorerEntry) == size &&
+                    buckets[bucket_count - 1] == header->entries;
+            }
+            if (!valid) {
+                cout << "Not an opening index: " << path << endl;
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+            file.close();
+            header = NULL;
+            buckets = NULL;
+            entries = NULL;
+        }
+
+        bool is_open() { return header != NULL; }
+        uint64_t getGames() { return header->games; }
+        uint64_t getEntries() { return header->entries; }
+
+        // Finds the moves played in a position, sorted by move. Returns NULL if the position isn't in the index.
+        // The entries point into the mapped file and stay valid until the index is closed.
+        const ExplorerEntry* find(uint64_t key, uint32_t& count) {
+            count = 0;
+            if (header == NULL) { return NULL; }
+            uint64_t bucket = header->bucket_bits == 0 ? 0 : key >> (64 - header->bucket_bits);
+            const ExplorerEntry* first = entries + buckets[bucket];
+            const ExplorerEntry* last = entries + buckets[bucket + 1];
+            first = lower_bound(first, last, key, [](const ExplorerEntry& entry, uint64_t key) { return entry.key < key; });
+            const ExplorerEntry* end = first;
+            while (end != last && end->key == key) { end++; }
+            count = end - first;
+            return count ? first : NULL;
+        }
+};
+
+// Replays game archives and writes the index of their openings
+class ExplorerBuilder {
+    private:
+        struct MoveKey {
+            uint64_t key;
+            PackedMove move;
+            bool operator==(const MoveKey& other) const { return key == other.key && move == other.move; }
+        };
+        struct MoveKeyHash {
+            size_t operator()(const MoveKey& k) const { return k.key ^ (k.move * 0x9E3779B97F4A7C15ULL); }
+        };
+        typedef unordered_map<MoveKey, ExplorerEntry, MoveKeyHash> Table;
+
+        string output;
+        int threads;
+        int max_plies;
+        size_t table_limit; // Counted moves per thread before its table is written as a run
+        mutex lock;
+        vector<string> runs;
+        atomic<uint64_t> games;
+        atomic<uint64_t> skipped;
+
+        // Sorts a table and writes it to a new run file
+        bool write_run(Table& table) {
+            vector<ExplorerEntry> sorted;
+            sorted.reserve(table.size());
+            for (auto& item : table) { sorted.push_back(item.second); }
+            table.clear();
+            sort(sorted.begin(), sorted.end(), explorer_less);
+            string path;
+            {
+                lock_guard<mutex> guard(lock);
+                path = output + ".run" + to_string(runs.size());
+                runs.push_back(path);
+            }
+            ofstream out(path, ios::binary | ios::trunc);
+            out.write((const char*)sorted.data(), sorted.size() * sizeof(ExplorerEntry));
+            if (!out) { cout << "Cannot write: " << path << endl; }
+            return (bool)out;
+        }
+
+        // Counts the moves of a game, games without a result are left out
+        void count_game(const ArchiveGame& game, Table& table) {
+            if (game.result == UNKNOWN_RESULT) {
+                skipped++;
+                return;
+            }
+            Position position;
+            if (!game.fen.empty() && !position.load_fen(game.fen)) { return; }
+            int plies = min((int)game.moves.size(), max_plies);
+            for (int i = 0; i < plies; i++) {
+                ExplorerEntry& entry = table[{ position.key, game.moves[i] }];
+                entry.key = position.key;
+                entry.move = game.moves[i];
+                if (game.result == WHITE_WINS) { entry.white_wins++; }
+                else if (game.result == BLACK_WINS) { entry.black_wins++; }
+                else { entry.draws++; }
+                Undo undo;
+                position.do_move(game.moves[i], undo);
+            }
+            games++;
+        }
+
+        // Replays the blocks of the archive that are left, one block at a time
+        bool work(string path, const ArchiveIndex& index, atomic<size_t>& next) {
+            ArchiveReader reader;
+            if (!reader.open(path)) { return false; }
+            Table table;
+            ArchiveGame game;
+            bool ok = true;
+            for (size_t block = next++; block < index.blocks.size() && ok; block = next++) {
+                uint32_t first = index.blocks[block].first_game;
+                uint32_t end = block + 1 < index.blocks.size() ? index.blocks[block + 1].first_game : index.games;
+                if (!reader.seek(first)) { break; }
+                for (uint32_t number = first; number < end && reader.next(game); number++) {
+                    count_game(game, table);
+                    if (table.size() >= table_limit) { ok = write_run(table); }
+                }
+            }
+            if (!table.empty() && ok) { ok = write_run(table); }
+            return ok;
+        }
+
+    public:
+        ExplorerBuilder(string output, int threads, int max_plies = EXPLORER_MAX_PLIES, int memory_mb = EXPLORER_MEMORY_MB)
+            : output(output), threads(max(1, threads)), max_plies(max_plies) {
+            table_limit = max<size_t>(1024, (size_t)memory_mb * 1024 * 1024 / EXPLORER_TABLE_ENTRY_BYTES / this->threads);
+            games = 0;
+            skipped = 0;
+        }
+
+        uint64_t getGames() { return games; }
+        uint64_t getSkipped() { return skipped; }
+
+        // Replays every game of an archive on all threads
+        bool add_archive(string path) {
+            ArchiveIndex index;
+            if (!read_archive_index(path, index)) {
+                cout << "Not a game archive: " << path << endl;
+                return false;
+            }
+            atomic<size_t> next(0);
+            atomic<bool> ok(true);
+            vector<thread> workers;
+            for (int i = 0; i < threads; i++) {
+                workers.emplace_back([&]() { if (!work(path, index, next)) { ok = false; } });
+            }
+            for (auto& w : workers) { w.join(); }
+            return ok;
+        }
+
+        // Merges the runs into the index, adding up the counts of the same move in the same position
+        bool finish() {
+            vector<unique_ptr<MappedFile>> files;
+            vector<const ExplorerEntry*> positions, ends;
+            for (auto& run : runs) {
+                files.push_back(make_unique<MappedFile>());
+                if (!files.back()->open(run)) {
+                    cout << "Cannot read: " << run << endl;
+                    return false;
+                }
+                positions.push_back((const ExplorerEntry*)files.back()->getData());
+                ends.push_back(positions.back() + files.back()->getSize() / sizeof(ExplorerEntry));
+            }
+            auto later = [&](size_t a, size_t b) { return explorer_less(*positions[b], *positions[a]); };
+            priority_queue<size_t, vector<size_t>, decltype(later)> queue(later);
+            for (size_t i = 0; i < positions.size(); i++) {
+                if (positions[i] != ends[i]) { queue.push(i); }
+            }
+
+            ofstream out(output, ios::binary | ios::trunc);
+            if (!out) {
+                cout << "Cannot write: " << output << endl;
+                return false;
+            }
+            vector<uint64_t> buckets((1 << EXPLORER_BUCKET_BITS) + 1, 0);
+            ExplorerHeader header = { { 'C', 'H', 'O', 'X' }, EXPLORER_VERSION, EXPLORER_BUCKET_BITS, 0, 0, games };
+            out.write((const char*)&header, sizeof(header));
+            out.write((const char*)buckets.data(), buckets.size() * sizeof(uint64_t));
+            ExplorerEntry current;
+            bool has_current = false;
+            auto flush = [&]() {
+                out.write((const char*)&current, sizeof(current));
+                buckets[(current.key >> (64 - EXPLORER_BUCKET_BITS)) + 1]++;
+                header.entries++;
+            };
+            while (!queue.empty()) {
+                size_t run = queue.top();
+                queue.pop();
+                const ExplorerEntry& entry = *positions[run]++;
+                if (positions[run] != ends[run]) { queue.push(run); }
+                if (has_current && current.key == entry.key && current.move == entry.move) {
+                    current.white_wins += entry.white_wins;
+                    current.draws += entry.draws;
+                    current.black_wins += entry.black_wins;
+                    continue;
+                }
+                if (has_current) { flush(); }
+                current = entry;
+                has_current = true;
+            }
+            if (has_current) { flush(); }
+            for (size_t i = 1; i < buckets.size(); i++) { buckets[i] += buckets[i - 1]; } // Counts to first entries
+            out.seekp(0);
+            out.write((const char*)&header, sizeof(header));
+            out.write((const char*)buckets.data(), buckets.size() * sizeof(uint64_t));
+            files.clear();
+            for (auto& run : runs) { remove(run.c_str()); }
+            runs.clear();
+            return (bool)out;
+        }
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Read only view of a whole file, mapped into memory so only the pages that are touched are read from disk.
+// Falls back to reading the file when it can't be mapped.
+class MappedFile {
+    private:
+        const uint8_t* data = NULL;
+        size_t size = 0;
+        vector<uint8_t> buffer; // Used when the file can't be mapped
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+#else
+        bool mapped = false;
+#endif
+
+        bool read_file(string path) {
+            ifstream in(path, ios::binary | ios::ate);
+            if (!in) { return false; }
+            buffer.resize(in.tellg());
+            in.seekg(0);
+            if (!in.read((char*)buffer.data(), buffer.size())) { return false; }
+            data = buffer.data();
+            size = buffer.size();
+            return true;
+        }
+
+    public:
+        MappedFile() {}
+        MappedFile(const MappedFile&) = delete;
+        ~MappedFile() { close(); }
+
+        // Maps the file, random_access tells the system not to read ahead of the touched pages
+        bool open(string path, bool random_access = false) {
+            close();
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                random_access ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) { return false; }
+            LARGE_INTEGER file_size;
+            GetFileSizeEx(file, &file_size);
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping != NULL) { data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0); }
+            size = data != NULL ? (size_t)file_size.QuadPart : 0;
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) { return false; }
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                void* view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (view != MAP_FAILED) {
+                    if (random_access) { madvise(view, info.st_size, MADV_RANDOM); }
+                    data = (const uint8_t*)view;
+                    size = info.st_size;
+                    mapped = true;
+                }
+            }
+            ::close(fd);
+#endif
+            if (data == NULL && !read_file(path)) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+#ifdef _WIN32
+            if (mapping != NULL && data != NULL) { UnmapViewOfFile(data); }
+            if (mapping != NULL) { CloseHandle(mapping); }
+            if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+            mapping = NULL;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (mapped) { munmap((void*)data, size); }
+            mapped = false;
+#endif
+            buffer.clear();
+            data = NULL;
+            size = 0;
+        }
+
+        bool is_open() { return data != NULL; }
+        const uint8_t* getData() { return data; }
+        size_t getSize() { return size; }
+};
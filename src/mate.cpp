@@ -0,0 +1,397 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include <position.cpp>
+#include <clock.cpp>
+
+using namespace std;
+
+// Mate solver with depth first proof number search (df-pn). It only asks whether the side to move can force mate,
+// so it spends its work on the moves that leave the defender the fewest replies, and proves deep mates with
+// narrow trees far faster than an alpha-beta search that has to look at every move to the same depth.
+//
+// Every node has two numbers from the view of its side to move: phi, the least number of leaves that still
+// have to be solved to show it wins, and delta, to show it loses. A node is won with phi = 0, lost with
+// delta = 0. The remaining plies are part of the key of a node, so "mate in N" is exact and the same position
+// at another depth is another node; as the plies always run out, there are no cycles.
+
+#define MATE_HASH_MB 64
+#define MATE_MAX_MOVES 64 // Deepest mate that can be asked for
+#define MATE_INFINITY (1u << 31)
+#define MATE_BUCKET 8 // Slots probed for a key
+#define MATE_GC_LOAD 75 // Percent of the slots in use before a full bucket starts a garbage collection
+#define MATE_GC_REPLACED 10 // Percent of the slots replaced in full buckets that start one at any load
+#define MATE_CHECK_NODES 4096 // Nodes between checks of the stop flag and the limits
+
+typedef struct {
+    uint64_t key; // 0 for a free slot
+    uint32_t phi;
+    uint32_t delta;
+    uint32_t work; // Nodes searched below this node, small trees are cheap to search again
+    uint16_t plies; // Of a node solved as a mate, the plies to mate when both sides play the best move of the proof
+    uint16_t unused;
+} MateEntry;
+
+// Table of the proof and disproof numbers with a fixed size. When it fills up, the entries of the smallest
+// subtrees are removed, which keeps the proofs of the larger ones.
+class MateTable {
+    private:
+        vector<MateEntry> entries;
+        uint64_t bucket_mask;
+        uint64_t used = 0;
+        uint64_t replaced = 0; // Entries replaced in full buckets since the last collection
+        int collections = 0;
+
+        MateEntry* bucket(uint64_t key) { return &entries[(key & bucket_mask) * MATE_BUCKET]; }
+
+        // Frees about half the table, the entries with the least work first
+        void collect() {
+            uint64_t histogram[33] = {};
+            for (auto& e : entries) {
+                if (e.key != 0) { histogram[32 - __builtin_clz(e.work | 1)]++; }
+            }
+            int limit = 0;
+            for (uint64_t freed = histogram[0]; limit < 32 && freed < used / 2; freed += histogram[++limit]) {}
+            for (auto& e : entries) {
+                if (e.key != 0 && 32 - __builtin_clz(e.work | 1) <= limit) {
+                    e.key = 0;
+                    used--;
+                }
+            }
+            replaced = 0;
+            collections++;
+        }
+
+    public:
+        MateTable(int megabytes = MATE_HASH_MB) { resize(megabytes); }
+
+        void resize(int megabytes) {
+            uint64_t buckets = 1;
+            while (buckets * 2 * MATE_BUCKET * sizeof(MateEntry) <= (uint64_t)megabytes << 20) { buckets *= 2; }
+            entries.assign(buckets * MATE_BUCKET, MateEntry {});
+            bucket_mask = buckets - 1;
+            used = 0;
+            replaced = 0;
+        }
+
+        void clear() {
+            fill(entries.begin(), entries.end(), MateEntry {});
+            used = 0;
+            replaced = 0;
+        }
+
+        const MateEntry* find(uint64_t key) {
+            MateEntry* b = bucket(key);
+            for (int i = 0; i < MATE_BUCKET; i++) {
+                if (b[i].key == key) { return &b[i]; }
+            }
+            return NULL;
+        }
+
+        void store(uint64_t key, uint32_t phi, uint32_t delta, uint32_t work, uint16_t plies) {
+            MateEntry* b = bucket(key);
+            MateEntry* slot = NULL;
+            for (int i = 0; i < MATE_BUCKET && slot == NULL; i++) {
+                if (b[i].key == key) { slot = &b[i]; }
+            }
+            for (int i = 0; i < MATE_BUCKET && slot == NULL; i++) {
+                if (b[i].key == 0) { slot = &b[i]; }
+            }
+            // Replacing in full buckets keeps the load flat, so a table whose keys crowd some buckets would
+            // otherwise never reach the load and only ever replace
+            if (slot == NULL && (used * 100 >= entries.size() * MATE_GC_LOAD || replaced * 100 >= entries.size() * MATE_GC_REPLACED)) {
+                collect();
+                for (int i = 0; i < MATE_BUCKET && slot == NULL; i++) {
+                    if (b[i].key == 0) { slot = &b[i]; }
+                }
+            }
+            if (slot == NULL) { // Replaces the smallest subtree of the bucket. The result is always kept, the
+                slot = b;        // search would otherwise come back to the same node without progress
+                for (int i = 1; i < MATE_BUCKET; i++) {
+                    if (b[i].work < slot->work) { slot = &b[i]; }
+                }
+                used--;
+                replaced++;
+            }
+            if (slot->key != key) { used++; }
+            *slot = { key, phi, delta, work, plies, 0 };
+        }
+
+        uint64_t getUsed() { return used; }
+        uint64_t getSize() { return entries.size(); }
+        int getCollections() { return collections; }
+};
+
+enum MateResult { MATE_FOUND, MATE_NONE, MATE_UNKNOWN };
+
+typedef struct {
+    MateResult result;
+    int moves; // Moves until mate along the proof, which with shortest is the fastest mate, or the moves searched
+    vector<PackedMove> line; // A mating line, the defender plays the reply that holds out longest
+    uint64_t nodes;
+    int time_ms;
+} MateAnswer;
+
+class MateSolver {
+    private:
+        typedef struct {
+            PackedMove move;
+            uint64_t key;
+        } MateChild;
+
+        MateTable table;
+        Position position;
+        uint64_t depth_keys[2 * MATE_MAX_MOVES];
+        uint64_t nodes;
+        uint64_t max_nodes;
+        int64_t deadline_us;
+        bool aborted;
+
+        uint64_t node_key(int remaining) {
+            uint64_t key = position.key ^ depth_keys[remaining];
+            return key != 0 ? key : 1;
+        }
+
+        void lookup(uint64_t key, uint32_t& phi, uint32_t& delta) {
+            const MateEntry* entry = table.find(key);
+            phi = entry != NULL ? entry->phi : 1;
+            delta = entry != NULL ? entry->delta : 1;
+        }
+
+        bool should_stop() {
+            if (aborted) { return true; }
+            nodes++;
+            if (max_nodes && nodes >= max_nodes) { aborted = true; }
+            else if (nodes % MATE_CHECK_NODES == 0) { aborted = stop || (deadline_us && clock_now_us() >= deadline_us); }
+            return aborted;
+        }
+
+        // Searches the node until its phi reaches th_phi or its delta th_delta, returns the nodes searched.
+        // The attacker moves when the remaining plies are odd.
+        uint32_t mid(uint32_t th_phi, uint32_t th_delta, int remaining) {
+            uint64_t key = node_key(remaining);
+            if (should_stop()) { return 1; }
+            bool attacker = remaining % 2 == 1;
+
+            // Decided without looking at the moves
+            if (remaining == 0) { // The attacker's moves are used up, the defender survives unless mated now
+                bool mated = !position.has_legal_move() && position.in_check();
+                table.store(key, mated ? MATE_INFINITY : 0, mated ? 0 : MATE_INFINITY, 1, 0);
+                return 1;
+            }
+            PackedMove list[MAX_MOVES];
+            int count = position.generate_moves(list);
+            if (count == 0) { // Mate loses for the side to move, stalemate only for the attacker
+                bool wins = !attacker && !position.in_check();
+                table.store(key, wins ? 0 : MATE_INFINITY, wins ? MATE_INFINITY : 0, 1, 0);
+                return 1;
+            }
+            MateChild children[MAX_MOVES];
+            int n = 0;
+            for (int i = 0; i < count; i++) {
+                Undo undo;
+                position.do_move(list[i], undo);
+                if (remaining > 1 || position.in_check()) { children[n++] = { list[i], node_key(remaining - 1) }; } // Mate in one is a check
+                position.undo_move(list[i], undo);
+            }
+
+            // Without moves, e.g. no check with one ply left, delta stays 0 and the node is lost
+            uint32_t work = 1, phi = MATE_INFINITY, delta = 0;
+            while (true) {
+                // phi is the least delta of the moves, delta the sum of their phi
+                uint64_t sum = 0;
+                uint32_t second = MATE_INFINITY, child_phi = 0;
+                int chosen = -1;
+                phi = MATE_INFINITY;
+                for (int i = 0; i < n; i++) {
+                    uint32_t p, d;
+                    lookup(children[i].key, p, d);
+                    sum += p;
+                    if (d < phi || chosen == -1) {
+                        second = phi;
+                        phi = d;
+                        child_phi = p;
+                        chosen = i;
+                    }
+                    else if (d < second) { second = d; }
+                }
+                delta = (uint32_t)min(sum, (uint64_t)MATE_INFINITY);
+                if (phi == 0 || delta == 0 || phi >= th_phi || delta >= th_delta || aborted) { break; }
+                uint32_t child_th_phi = (uint32_t)min((uint64_t)th_delta + child_phi - delta, (uint64_t)MATE_INFINITY);
+                // Stays in the child until it is a quarter worse than the second best, instead of switching as soon
+                // as it is worse, so the search doesn't keep going back and forth between two moves (1 + epsilon)
+                uint32_t child_th_delta = min(th_phi, second == MATE_INFINITY ? second : second + 1 + second / 4);
+                Undo undo;
+                position.do_move(children[chosen].move, undo);
+                uint32_t searched = mid(child_th_phi, child_th_delta, remaining - 1);
+                position.undo_move(children[chosen].move, undo);
+                work = work + searched < work ? UINT32_MAX : work + searched;
+            }
+            if (aborted) { return work; }
+            uint16_t plies = 0;
+            if (attacker ? phi == 0 : delta == 0) { // Mates, the attacker takes the fastest and the defender the slowest
+                for (int i = 0; i < n; i++) {
+                    const MateEntry* entry = table.find(children[i].key);
+                    int child = entry != NULL ? entry->plies : remaining - 1; // Collected, at most all the plies left
+                    if (attacker && (entry == NULL || entry->delta != 0)) { continue; }
+                    if (plies == 0 || (attacker ? child + 1 < plies : child + 1 > plies)) { plies = child + 1; }
+                }
+            }
+            table.store(key, phi, delta, work, plies);
+            return work;
+        }
+
+        // Move of the proof in a node solved as a mate, NULL_MOVE if the node is mate or no longer in the table
+        PackedMove proof_move(int remaining) {
+            bool attacker = remaining % 2 == 1;
+            PackedMove list[MAX_MOVES];
+            int count = position.generate_moves(list);
+            PackedMove move = NULL_MOVE;
+            int plies = 0;
+            for (int i = 0; i < count; i++) {
+                Undo undo;
+                position.do_move(list[i], undo);
+                const MateEntry* entry = table.find(node_key(remaining - 1));
+                position.undo_move(list[i], undo);
+                if (entry == NULL || (attacker ? entry->delta != 0 : entry->phi != 0)) { continue; }
+                if (move == NULL_MOVE || (attacker ? entry->plies < plies : entry->plies > plies)) {
+                    move = list[i];
+                    plies = entry->plies;
+                }
+            }
+            return move;
+        }
+
+        // Follows the proof from the root
+        vector<PackedMove> mating_line(Position root, int remaining) {
+            vector<PackedMove> line;
+            position = root;
+            for (; remaining > 0; remaining--) {
+                PackedMove move = proof_move(remaining);
+                if (move == NULL_MOVE) { break; } // Mate, or the rest of the proof was collected
+                line.push_back(move);
+                Undo undo;
+                position.do_move(move, undo);
+            }
+            return line;
+        }
+
+    public:
+        atomic<bool> stop; // Set by another thread to end the search, reset by the owner before the next one
+
+        MateSolver(int megabytes = MATE_HASH_MB) : table(megabytes) {
+            stop = false;
+            uint64_t seed = 0x6d617465736f6c76ULL;
+            for (auto& k : depth_keys) { // splitmix64
+                uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                k = z ^ (z >> 31);
+            }
+        }
+
+        MateTable& getTable() { return table; }
+
+        // Answers if the side to move can mate in at most max_moves moves. With shortest, every smaller number
+        // of moves is tried first, so a found mate is the fastest one. 0 means no limit for the nodes and time.
+        MateAnswer solve(const Position& root, int max_moves, bool shortest = false, uint64_t node_limit = 0, int time_ms = 0) {
+            int64_t start = clock_now_us();
+            max_moves = max(1, min(max_moves, MATE_MAX_MOVES));
+            max_nodes = node_limit;
+            deadline_us = time_ms ? start + time_ms * 1000LL : 0;
+            nodes = 0;
+            aborted = stop;
+            MateAnswer answer = { MATE_NONE, max_moves, {}, 0, 0 };
+            for (int moves = shortest ? 1 : max_moves; moves <= max_moves; moves++) {
+                position = root;
+                int remaining = 2 * moves - 1;
+                uint32_t phi = 1, delta = 1;
+                while (phi != 0 && delta != 0 && !aborted) {
+                    mid(MATE_INFINITY, MATE_INFINITY, remaining);
+                    lookup(node_key(remaining), phi, delta);
+                }
+                if (aborted) {
+                    answer.result = MATE_UNKNOWN;
+                    answer.moves = moves;
+                    break;
+                }
+                if (phi == 0) {
+                    answer.result = MATE_FOUND;
+                    const MateEntry* entry = table.find(node_key(remaining));
+                    answer.moves = entry != NULL ? (entry->plies + 1) / 2 : moves;
+                    answer.line = mating_line(root, remaining);
+                    break;
+                }
+            }
+            answer.nodes = nodes;
+            answer.time_ms = (clock_now_us() - start) / 1000;
+            return answer;
+        }
+};
+
+#define MATE_FIND_MOVES 12 // Deepest mate looked for from the window
+#define MATE_FIND_MS 10000
+
+// Runs the mate solver on a background thread, so the window keeps running while it works
+class MateFinder {
+    private:
+        MateSolver solver;
+        thread worker;
+        mutex lock;
+        bool running = false;
+        MateAnswer answer = { MATE_UNKNOWN, 0, {}, 0, 0 };
+        int version = 0;
+
+    public:
+        ~MateFinder() { stop(); }
+
+        bool is_running() {
+            lock_guard<mutex> guard(lock);
+            return running;
+        }
+
+        // Looks for the shortest mate of the side to move in the position, replacing an earlier search
+        void start(const Position& position, int max_moves, int time_ms) {
+            stop();
+            solver.stop = false;
+            solver.getTable().clear();
+            {
+                lock_guard<mutex> guard(lock);
+                running = true;
+                version++;
+            }
+            worker = thread([this, position, max_moves, time_ms] {
+                MateAnswer found = solver.solve(position, max_moves, true, 0, time_ms);
+                lock_guard<mutex> guard(lock);
+                answer = found;
+                running = false;
+                version++;
+            });
+        }
+
+        void stop() {
+            if (!worker.joinable()) { return; }
+            solver.stop = true;
+            worker.join();
+            lock_guard<mutex> guard(lock);
+            running = false;
+            answer = { MATE_UNKNOWN, 0, {}, 0, 0 };
+            version++;
+        }
+
+        // Copies the answer if it changed since the given version, returns false otherwise
+        bool poll(MateAnswer& out, bool& searching, int& seen_version) {
+            lock_guard<mutex> guard(lock);
+            if (seen_version == version) { return false; }
+            out = answer;
+            searching = running;
+            seen_version = version;
+            return true;
+        }
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Counters of what the rules, the search and the window do, for monitoring and the debug view.
+// Every thread counts into its own block, which only that thread writes, so counting is a plain load and store
+// without locks or atomic read-modify-write. The blocks are summed when the counters are read. A block is
+// handed to the next new thread when its thread ends, so the counts of finished threads are kept.
+
+enum Metric {
+    METRIC_MOVES_GENERATED,
+    METRIC_TARGET_UPDATES,
+    METRIC_LEGAL_CACHE_HITS,
+    METRIC_LEGAL_CACHE_MISSES,
+    METRIC_TT_PROBES,
+    METRIC_TT_HITS,
+    METRIC_SEARCH_NODES,
+    METRIC_BITBASE_HITS,
+    METRIC_FRAMES,
+    METRIC_COUNT
+};
+
+// Name and help text of each metric in the Prometheus text format, all are counters
+static const char* metric_names[METRIC_COUNT][2] = {
+    { "chess_moves_generated_total", "Pseudo legal moves generated" },
+    { "chess_target_field_updates_total", "Target field updates of the board pieces" },
+    { "chess_legal_cache_hits_total", "Legal move lists of the board found in the cache" },
+    { "chess_legal_cache_misses_total", "Legal move lists of the board computed" },
+    { "chess_tt_probes_total", "Transposition table probes" },
+    { "chess_tt_hits_total", "Transposition table probes that found the position" },
+    { "chess_search_nodes_total", "Nodes searched" },
+    { "chess_bitbase_hits_total", "Search nodes decided by the endgame bitbases" },
+    { "chess_frames_total", "Frames rendered" },
+};
+
+#define METRICS_PORT_POLL_MS 200 // How often the stats socket checks if it should stop
+#define METRICS_CLIENT_TIMEOUT_MS 1000 // How long a scraper may take to send its request and read the answer
+
+// Counters of one thread, on their own cache line so threads don't slow each other down
+typedef struct alignas(64) {
+    atomic<uint64_t> values[METRIC_COUNT];
+} MetricBlock;
+
+class Metrics {
+    private:
+        mutex lock; // Only taken when a thread starts or ends counting, and to list the blocks
+        vector<MetricBlock*> blocks;
+        vector<MetricBlock*> free_blocks;
+
+        // Gives the block back when the thread ends
+        struct ThreadBlock {
+            MetricBlock* block = NULL;
+            ~ThreadBlock() { if (block != NULL) { instance().release(block); } }
+        };
+
+        MetricBlock* acquire() {
+            lock_guard<mutex> guard(lock);
+            if (!free_blocks.empty()) {
+                MetricBlock* block = free_blocks.back();
+                free_blocks.pop_back();
+                return block;
+            }
+            MetricBlock* block = new MetricBlock;
+            for (auto& v : block->values) { v.store(0, memory_order_relaxed); }
+            blocks.push_back(block);
+            return block;
+        }
+
+        void release(MetricBlock* block) {
+            lock_guard<mutex> guard(lock);
+            free_blocks.push_back(block);
+        }
+
+    public:
+        static Metrics& instance() {
+            static Metrics metrics;
+            return metrics;
+        }
+
+        // The block of the calling thread. The plain pointer is read directly, the holder with the destructor
+        // is only touched the first time.
+        static MetricBlock& local() {
+            static thread_local MetricBlock* block = NULL;
+            if (block == NULL) {
+                thread_local ThreadBlock holder;
+                holder.block = block = instance().acquire();
+            }
+            return *block;
+        }
+
+        // Sum of every thread's counters
+        vector<uint64_t> snapshot() {
+            vector<uint64_t> totals(METRIC_COUNT, 0);
+            lock_guard<mutex> guard(lock);
+            for (auto& block : blocks) {
+                for (int i = 0; i < METRIC_COUNT; i++) { totals[i] += block->values[i].load(memory_order_relaxed); }
+            }
+            return totals;
+        }
+
+        // All counters in the Prometheus text format
+        string prometheus_text() {
+            vector<uint64_t> totals = snapshot();
+            string text;
+            for (int i = 0; i < METRIC_COUNT; i++) {
+                text += (string)"# HELP " + metric_names[i][0] + " " + metric_names[i][1] + "\n";
+                text += (string)"# TYPE " + metric_names[i][0] + " counter\n";
+                text += (string)metric_names[i][0] + " " + to_string(totals[i]) + "\n";
+            }
+            return text;
+        }
+
+        // Writes the counters to a file for a node exporter's text collector. The file is replaced at once,
+        // so a scrape never sees it half written or missing. Windows can't rename over a file, there it is
+        // missing for a moment.
+        bool write_file(string path) {
+            string temporary = path + ".tmp";
+            {
+                ofstream out(temporary, ios::trunc);
+                out << prometheus_text();
+                if (!out) { return false; }
+            }
+#ifdef _WIN32
+            remove(path.c_str()); // Only POSIX rename replaces an existing file
+#endif
+            return rename(temporary.c_str(), path.c_str()) == 0;
+        }
+};
+
+// Adds to a counter of the calling thread
+inline void count_metric(Metric metric, uint64_t n = 1) {
+    atomic<uint64_t>& value = Metrics::local().values[metric];
+    value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// Serves the counters over HTTP on a local port, every request gets the Prometheus text.
+// Only listens on 127.0.0.1, the stats are for a scraper on the same machine.
+class MetricsServer {
+    private:
+        thread worker;
+        atomic<bool> quit;
+#ifndef _WIN32
+        int listener = -1;
+
+        void loop() {
+            while (!quit) {
+                pollfd waiting = { listener, POLLIN, 0 };
+                if (::poll(&waiting, 1, METRICS_PORT_POLL_MS) <= 0) { continue; }
+                int fd = accept(listener, NULL, NULL);
+                if (fd < 0) { continue; }
+                timeval timeout = { METRICS_CLIENT_TIMEOUT_MS / 1000, METRICS_CLIENT_TIMEOUT_MS % 1000 * 1000 };
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)); // A silent client can't block stop()
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                char request[1024];
+                recv(fd, request, sizeof(request), 0); // The request itself doesn't matter
+                string body = Metrics::instance().prometheus_text();
+                string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                    to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+                for (size_t sent = 0; sent < response.size();) {
+                    ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                    if (n <= 0) { break; }
+                    sent += n;
+                }
+                ::close(fd);
+            }
+        }
+#endif
+
+    public:
+        MetricsServer() { quit = false; }
+        ~MetricsServer() { stop(); }
+
+        bool start(int port) {
+#ifndef _WIN32
+            listener = socket(AF_INET, SOCK_STREAM, 0);
+            int on = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(port);
+            if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 16) != 0) {
+                cout << "Cannot serve metrics on port " << port << endl;
+                ::close(listener);
+                listener = -1;
+                return false;
+            }
+            quit = false;
+            worker = thread(&MetricsServer::loop, this);
+            return true;
+#else
+            cout << "The metrics port is not available on this platform, use a metrics file\n";
+            return false;
+#endif
+        }
+
+        void stop() {
+            if (!worker.joinable()) { return; }
+            quit = true;
+            worker.join();
+#ifndef _WIN32
+            ::close(listener);
+            listener = -1;
+#endif
+        }
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <mapped.cpp>
+
+using namespace std;
+
+// Asset pack: every file the game loads in one file, so starting needs a single open, or none when the pack
+// is embedded in the executable. The pack is mapped into memory and the files are decoded straight from it.
+//
+// File layout, all numbers little endian and stored as they are in memory:
+//   header   PackHeader
+//   index    PackEntry for every file, sorted by name
+//   data     the files, each starting at a multiple of PACK_ALIGNMENT
+// Names are paths relative to the game folder with forward slashes, e.g. "assets/sounds/move.mp3".
+
+#define PACK_VERSION 1
+#define PACK_NAME_LENGTH 48 // Including the terminating 0
+#define PACK_ALIGNMENT 16
+#define PACK_PATH "assets.chpk" // Next to the assets folder
+
+typedef struct {
+    char magic[4]; // "CHPK"
+    uint32_t version;
+    uint32_t entries;
+    uint32_t reserved;
+} PackHeader;
+
+typedef struct {
+    uint64_t offset; // From the start of the pack
+    uint64_t size;
+    char name[PACK_NAME_LENGTH];
+} PackEntry;
+
+static_assert(sizeof(PackHeader) == 16 && sizeof(PackEntry) == 64, "The pack layout has to stay fixed");
+
+#ifdef CHESS_EMBEDDED_PACK
+// Written by chess-pack embed, and compiled into the executable
+extern "C" const unsigned char chess_asset_pack[];
+extern "C" const size_t chess_asset_pack_size;
+#endif
+
+// Read only view of a pack, from a memory mapped file or from memory that stays valid
+class AssetPack {
+    private:
+        const uint8_t* data = NULL;
+        size_t size = 0;
+        const PackEntry* entries = NULL;
+        uint32_t count = 0;
+        MappedFile file;
+
+        // Checks the header and that the index and every file lie inside the pack
+        bool validate() {
+            const PackHeader* header = (const PackHeader*)data;
+            if (size < sizeof(PackHeader) || memcmp(header->magic, "CHPK", 4) != 0 || header->version != PACK_VERSION) {
+                return false;
+            }
+            if (header->entries > (size - sizeof(PackHeader)) / sizeof(PackEntry)) { return false; }
+            entries = (const PackEntry*)(data + sizeof(PackHeader));
+            count = header->entries;
+            for (uint32_t i = 0; i < count; i++) {
+                const PackEntry& entry = entries[i];
+                if (entry.offset > size || entry.size > size - entry.offset || entry.name[PACK_NAME_LENGTH - 1] != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    public:
+        AssetPack() {}
+        AssetPack(const AssetPack&) = delete;
+        ~AssetPack() { close(); }
+
+        // Maps the pack file into memory, returns false if it doesn't exist or isn't a pack
+        bool open(string path) {
+            close();
+            if (!file.open(path)) { return false; }
+            data = file.getData();
+            size = file.getSize();
+            if (!validate()) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        // Uses a pack that is already in memory, which has to stay valid while the pack is used
+        bool open_memory(const uint8_t* memory, size_t length) {
+            close();
+            data = memory;
+            size = length;
+            if (!validate()) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        // Uses the pack compiled into the executable, if there is one
+        bool open_embedded() {
+#ifdef CHESS_EMBEDDED_PACK
+            return open_memory(chess_asset_pack, chess_asset_pack_size);
+#else
+            return false;
+#endif
+        }
+
+        void close() {
+            file.close();
+            data = NULL;
+            size = 0;
+            entries = NULL;
+            count = 0;
+        }
+
+        bool is_open() { return data != NULL; }
+        uint32_t getCount() { return count; }
+        const PackEntry& getEntry(uint32_t i) { return entries[i]; }
+
+        // Finds a file by name, returns NULL if the pack doesn't have it
+        const uint8_t* find(string name, size_t& length) {
+            const PackEntry* end = entries + count;
+            const PackEntry* it = lower_bound(entries, end, name, [](const PackEntry& entry, const string& name) {
+                return strcmp(entry.name, name.c_str()) < 0;
+            });
+            if (it == end || name != it->name) { return NULL; }
+            length = it->size;
+            return data + it->offset;
+        }
+
+        // Names of all files in the given folder and its subfolders, e.g. "assets/sounds/"
+        vector<string> list(string folder) {
+            vector<string> names;
+            for (uint32_t i = 0; i < count; i++) {
+                if (strncmp(entries[i].name, folder.c_str(), folder.length()) == 0) { names.push_back(entries[i].name); }
+            }
+            return names;
+        }
+};
+
+// Writes a pack of the given files. The names are stored as given, the files are read from root + "/" + name.
+inline bool write_pack(string root, vector<string> names, string output) {
+    sort(names.begin(), names.end());
+    vector<PackEntry> entries(names.size());
+    vector<vector<char>> files(names.size());
+    uint64_t offset = sizeof(PackHeader) + names.size() * sizeof(PackEntry);
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i].length() >= PACK_NAME_LENGTH) {
+            cout << "Name too long for the pack: " << names[i] << endl;
+            return false;
+        }
+        ifstream in(root + "/" + names[i], ios::binary);
+        if (!in) {
+            cout << "Cannot read: " << root + "/" + names[i] << endl;
+            return false;
+        }
+        files[i].assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        offset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+        memset(&entries[i], 0, sizeof(PackEntry));
+        entries[i].offset = offset;
+        entries[i].size = files[i].size();
+        strcpy(entries[i].name, names[i].c_str());
+        offset += files[i].size();
+    }
+
+    ofstream out(output, ios::binary | ios::trunc);
+    if (!out) {
+        cout << "Cannot write: " << output << endl;
+        return false;
+    }
+    PackHeader header = { { 'C', 'H', 'P', 'K' }, PACK_VERSION, (uint32_t)names.size(), 0 };
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)entries.data(), entries.size() * sizeof(PackEntry));
+    uint64_t position = sizeof(PackHeader) + entries.size() * sizeof(PackEntry);
+    for (size_t i = 0; i < names.size(); i++) {
+        string padding(entries[i].offset - position, '\0');
+        out.write(padding.data(), padding.size());
+        out.write(files[i].data(), files[i].size());
+        position = entries[i].offset + files[i].size();
+    }
+    return (bool)out;
+}
@@ -3,15 +3,15 @@
 #include <vector>
 
 #include <entity.cpp>
+#include <types.h>
 
 using namespace std;
 
-enum Color { BLACK, WHITE };
-
 // Base class for all chess pieces
 class Piece {
     protected:
         bool pawn = false;
+        PieceType type;
         int board_size, board_posX, board_posY;
         Entity entity;
         Color color;
@@ -62,6 +62,7 @@ class Piece {
     public:
         // public getters and setters
         bool isPawn() { return pawn; }
+        PieceType getType() { return type; }
         string getField() { return field; }
         Color getColor() { return color; }
         Entity getEntity() { return entity; }
@@ -72,6 +73,11 @@ class Piece {
             // Base class polymorphic function
         }
 
+        // Takes the castling rights and en passant field of the board, used by the king and pawn movement
+        virtual void update_rules(int castling, string en_passant) {
+            // Base class polymorphic function
+        }
+
         // Virtual destructor
         virtual ~Piece() {}
 
@@ -94,8 +100,8 @@ class Piece {
 
         // Update this field based on the given field.
         void update_field(string field_str) {
-            bool validX;
-            bool validY;
+            bool validX = false;
+            bool validY = false;
             for (int i = 0; i < 8; i++) {
                 if (field_str[0] == i+65 || field_str[0] == 73) { validX = true; }
                 if (field_str[1] == i+49) { validY = true; }
@@ -111,12 +117,16 @@ class Piece {
 
 // Class to represent the pawn piece
 class Pawn : public Piece {
+    private:
+        string en_passant;
+
     public:
         Pawn(int board_size, int board_posX, int board_posY, string field_str, Color color) {
             this->board_size = board_size;
             this->board_posX = board_posX;
             this->board_posY = board_posY;
             this->color = color;
+            this->type = PAWN;
             this->pawn = true;
             string fileName;
             if (color == WHITE) { fileName = "white_pawn.png"; }
@@ -172,6 +182,15 @@ class Pawn : public Piece {
                     }
                 }
             }
+            // Check en passant, the field behind a pawn that just moved two fields
+            if (!en_passant.empty() && en_passant[1] == field[1] + (color == WHITE ? 1 : -1) &&
+            (en_passant[0] == field[0] + 1 || en_passant[0] == field[0] - 1)) {
+                target_fields.push_back(en_passant);
+            }
+        }
+
+        void update_rules(int castling, string en_passant) override {
+            this->en_passant = en_passant;
         }
 };
 
@@ -183,6 +202,7 @@ class Rook : public Piece {
             this->board_posX = board_posX;
             this->board_posY = board_posY;
             this->color = color;
+            this->type = ROOK;
             string fileName;
             if (color == WHITE) { fileName = "white_rook.png"; }
             else if (color == BLACK) { fileName = "black_rook.png"; }
@@ -209,6 +229,7 @@ class Knight : public Piece {
             this->board_posX = board_posX;
             this->board_posY = board_posY;
             this->color = color;
+            this->type = KNIGHT;
             string fileName;
             if (color == WHITE) { fileName = "white_knight.png"; }
             else if (color == BLACK) { fileName = "black_knight.png"; }
@@ -239,6 +260,7 @@ class Bishop : public Piece {
             this->board_posX = board_posX;
             this->board_posY = board_posY;
             this->color = color;
+            this->type = BISHOP;
             string fileName;
             if (color == WHITE) { fileName = "white_bishop.png"; }
             else if (color == BLACK) { fileName = "black_bishop.png"; }
@@ -265,6 +287,7 @@ class Queen : public Piece {
             this->board_posX = board_posX;
             this->board_posY = board_posY;
             this->color = color;
+            this->type = QUEEN;
             string fileName;
             if (color == WHITE) { fileName = "white_queen.png"; }
             else if (color == BLACK) { fileName = "black_queen.png"; }
@@ -289,12 +312,24 @@ class Queen : public Piece {
 
 // Class to represent the king piece
 class King : public Piece {
+    private:
+        int castling = 0;
+
+        // Checks if no piece stands on the given fields of the king's rank
+        bool fields_empty(string files, vector<Piece*>& pieces) {
+            for (const auto& p : pieces) {
+                if (p->getField()[1] == field[1] && files.find(p->getField()[0]) != string::npos) { return false; }
+            }
+            return true;
+        }
+
     public:
         King(int board_size, int board_posX, int board_posY, string field_str, Color color) {
             this->board_size = board_size;
             this->board_posX = board_posX;
             this->board_posY = board_posY;
             this->color = color;
+            this->type = KING;
             string fileName;
             if (color == WHITE) { fileName = "white_king.png"; }
             else if (color == BLACK) { fileName = "black_king.png"; }
@@ -314,5 +349,19 @@ class King : public Piece {
         update_relative_field(1, -1, pieces);
         update_relative_field(-1, 1, pieces);
         update_relative_field(-1, -1, pieces);
+
+        // Castling targets, the board checks that the king doesn't pass an attacked field
+        int king_side = color == WHITE ? WHITE_KING_SIDE : BLACK_KING_SIDE;
+        int queen_side = color == WHITE ? WHITE_QUEEN_SIDE : BLACK_QUEEN_SIDE;
+        if ((castling & king_side) && fields_empty("FG", pieces)) {
+            target_fields.push_back({'G', field[1]});
+        }
+        if ((castling & queen_side) && fields_empty("BCD", pieces)) {
+            target_fields.push_back({'C', field[1]});
+        }
+    }
+
+    void update_rules(int castling, string en_passant) override {
+        this->castling = castling;
     }
 };
\ No newline at end of file
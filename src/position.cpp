@@ -0,0 +1,725 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include <types.h>
+#include <metrics.cpp>
+
+using namespace std;
+
+// Compact rules state without any SDL dependency, used wherever many positions are kept at once.
+// Squares are numbered 0 (A1) to 63 (H8), rank by rank.
+
+// A move packed into 16 bits: from (6 bits), to (6 bits) and the promotion piece type (3 bits)
+typedef uint16_t PackedMove;
+
+#define NULL_MOVE 0
+#define MAX_MOVES 256
+#define MAX_PIECE_MOVES 32 // A queen has at most 27 moves, a pawn 12 and a king 10
+#define NO_SQUARE -1
+
+// Pieces are stored as their type with the color in bit 3, 0 is an empty square
+inline uint8_t make_piece(PieceType type, Color color) { return type | (color << 3); }
+inline PieceType piece_type(uint8_t piece) { return (PieceType)(piece & 7); }
+inline Color piece_color(uint8_t piece) { return (Color)(piece >> 3); }
+
+inline int square_file(int square) { return square & 7; }
+inline int square_rank(int square) { return square >> 3; }
+inline int make_square(int file, int rank) { return rank * 8 + file; }
+
+inline PackedMove make_move(int from, int to, PieceType promotion = NO_PIECE_TYPE) {
+    return from | (to << 6) | (promotion << 12);
+}
+inline int move_from(PackedMove move) { return move & 63; }
+inline int move_to(PackedMove move) { return (move >> 6) & 63; }
+inline PieceType move_promotion(PackedMove move) { return (PieceType)((move >> 12) & 7); }
+
+// Square name in the same format as the fields of the board, e.g. "E2"
+inline string square_name(int square) {
+    return { char('A' + square_file(square)), char('1' + square_rank(square)) };
+}
+
+// Parses a square name in upper or lower case, returns -1 if it isn't a square
+inline int parse_square(string name) {
+    if (name.length() < 2) { return -1; }
+    int file = toupper(name[0]) - 'A';
+    int rank = name[1] - '1';
+    if (file < 0 || file > 7 || rank < 0 || rank > 7) { return -1; }
+    return make_square(file, rank);
+}
+
+// Move in coordinate notation, e.g. "e2e4" or "e7e8q"
+inline string move_name(PackedMove move) {
+    string name = square_name(move_from(move)) + square_name(move_to(move));
+    for (auto& c : name) { c = tolower(c); }
+    if (move_promotion(move) != NO_PIECE_TYPE) { name += " pnbrqk"[move_promotion(move)]; }
+    return name;
+}
+
+// Random keys for hashing positions, generated once with splitmix64 so they are the same in every run
+struct Zobrist {
+    uint64_t pieces[16][64];
+    uint64_t turn;
+    uint64_t castling[16];
+    uint64_t en_passant[8];
+
+    Zobrist() {
+        uint64_t seed = 0x9E3779B97F4A7C15ULL;
+        for (int p = 0; p < 16; p++) {
+            for (int s = 0; s < 64; s++) { pieces[p][s] = next(seed); }
+        }
+        turn = next(seed);
+        castling[0] = 0;
+        for (int c = 1; c < 16; c++) { castling[c] = next(seed); }
+        for (int f = 0; f < 8; f++) { en_passant[f] = next(seed); }
+    }
+
+    static uint64_t next(uint64_t& seed) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+};
+
+static const Zobrist zobrist;
+
+// Precomputed target squares for every square, so move generation never has to check the board edges
+struct MoveTables {
+    uint8_t knight[64][8];
+    uint8_t knight_count[64];
+    uint8_t king[64][8];
+    uint8_t king_count[64];
+    uint8_t ray[64][8][7]; // Directions 0-3 are orthogonal, 4-7 are diagonal
+    uint8_t ray_length[64][8];
+    uint8_t castling_mask[64]; // Castling rights kept when a piece moves from or to the square
+
+    MoveTables() {
+        const int knight_steps[8][2] = { {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2} };
+        const int directions[8][2] = { {0, 1}, {1, 0}, {0, -1}, {-1, 0}, {1, 1}, {1, -1}, {-1, -1}, {-1, 1} };
+        for (int s = 0; s < 64; s++) {
+            int file = square_file(s), rank = square_rank(s);
+            castling_mask[s] = ALL_CASTLING;
+            knight_count[s] = 0;
+            king_count[s] = 0;
+            for (int i = 0; i < 8; i++) {
+                int f = file + knight_steps[i][0], r = rank + knight_steps[i][1];
+                if (f >= 0 && f < 8 && r >= 0 && r < 8) { knight[s][knight_count[s]++] = make_square(f, r); }
+                f = file + directions[i][0], r = rank + directions[i][1];
+                if (f >= 0 && f < 8 && r >= 0 && r < 8) { king[s][king_count[s]++] = make_square(f, r); }
+                ray_length[s][i] = 0;
+                for (f = file + directions[i][0], r = rank + directions[i][1]; f >= 0 && f < 8 && r >= 0 && r < 8;
+                    f += directions[i][0], r += directions[i][1]) {
+                    ray[s][i][ray_length[s][i]++] = make_square(f, r);
+                }
+            }
+        }
+        castling_mask[make_square(0, 0)] = ALL_CASTLING & ~WHITE_QUEEN_SIDE;
+        castling_mask[make_square(4, 0)] = ALL_CASTLING & ~(WHITE_KING_SIDE | WHITE_QUEEN_SIDE);
+        castling_mask[make_square(7, 0)] = ALL_CASTLING & ~WHITE_KING_SIDE;
+        castling_mask[make_square(0, 7)] = ALL_CASTLING & ~BLACK_QUEEN_SIDE;
+        castling_mask[make_square(4, 7)] = ALL_CASTLING & ~(BLACK_KING_SIDE | BLACK_QUEEN_SIDE);
+        castling_mask[make_square(7, 7)] = ALL_CASTLING & ~BLACK_KING_SIDE;
+    }
+};
+
+static const MoveTables move_tables;
+
+// Which moves to generate. Tactical moves are captures, en passant and queen promotions, quiet moves the rest.
+enum MoveGen { GEN_ALL, GEN_TACTICAL, GEN_QUIET };
+
+// Everything needed to take back a move
+typedef struct {
+    uint8_t captured;
+    uint8_t castling;
+    int8_t en_passant;
+    uint16_t halfmove_clock;
+    uint64_t key;
+} Undo;
+
+// Class to represent a position with the same rules as the board
+class Position {
+    public:
+        uint8_t squares[64];
+        Color turn;
+        uint8_t king_square[2];
+        uint8_t castling;
+        int8_t en_passant; // Square a pawn can capture en passant, only set when an opponent pawn is next to it
+        uint16_t halfmove_clock; // Plies since the last capture or pawn move
+        uint16_t fullmove;
+        uint64_t key;
+        vector<uint64_t> history; // Keys of the positions before each move, used to find repetitions
+
+        Position() { reset(); }
+
+        // Sets up the start position
+        void reset() {
+            load_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+        }
+
+        // Loads a position from a FEN string, returns false if it can't be parsed.
+        // The move counters are optional, so the first four fields of an EPD line also work.
+        bool load_fen(string fen) {
+            istringstream stream(fen);
+            string placement, side, castling_str = "-", en_passant_str = "-";
+            int halfmove = 0, fullmove_number = 1;
+            stream >> placement >> side >> castling_str >> en_passant_str;
+            if (!(stream >> halfmove >> fullmove_number)) { halfmove = 0, fullmove_number = 1; }
+            uint8_t parsed[64] = { 0 };
+            int file = 0, rank = 7;
+            for (char c : placement) {
+                if (c == '/') {
+                    if (file != 8 || rank == 0) { return false; }
+                    file = 0;
+                    rank--;
+                }
+                else if (c >= '1' && c <= '8') { file += c - '0'; }
+                else {
+                    const char* names = " pnbrqk";
+                    const char* found = strchr(names, tolower(c));
+                    if (c == ' ' || found == NULL || file > 7) { return false; }
+                    Color color = isupper(c) ? WHITE : BLACK;
+                    PieceType type = (PieceType)(found - names);
+                    parsed[make_square(file, rank)] = make_piece(type, color);
+                    file++;
+                }
+                if (file > 8) { return false; }
+            }
+            if (file != 8 || rank != 0) { return false; }
+            if (side != "w" && side != "b") { return false; }
+            int rights = 0;
+            for (char c : castling_str) {
+                const char* names = "KQkq";
+                const char* found = strchr(names, c);
+                if (c == '-') { continue; }
+                if (c == '\0' || found == NULL) { return false; }
+                rights |= 1 << (found - names);
+            }
+            int ep_square = en_passant_str == "-" ? NO_SQUARE : parse_square(en_passant_str);
+            if (en_passant_str != "-" && ep_square == NO_SQUARE) { return false; }
+            return load(parsed, side == "w" ? WHITE : BLACK, rights, ep_square, halfmove, fullmove_number);
+        }
+
+        // Loads a position from its pieces, returns false if a square holds no valid piece, a side hasn't exactly
+        // one king, more than 16 pieces or more than 8 pawns, or a pawn stands on the first or last rank. Those
+        // limits keep the moves of every position within MAX_MOVES. Castling rights without the king and rook on
+        // their squares, and an en passant square no pawn can capture on, are dropped. Doesn't allocate, so
+        // positions can be loaded in tight loops.
+        bool load(const uint8_t* pieces, Color side, int rights, int ep_square, int halfmove, int fullmove_number) {
+            int kings[2] = { -1, -1 };
+            int counts[2] = { 0, 0 }, pawns[2] = { 0, 0 };
+            for (int square = 0; square < 64; square++) {
+                uint8_t piece = pieces[square];
+                if (piece == 0) { continue; }
+                if (piece > 15 || piece_type(piece) == NO_PIECE_TYPE || piece_type(piece) > KING) { return false; }
+                if (++counts[piece_color(piece)] > 16) { return false; }
+                if (piece_type(piece) == PAWN) {
+                    if (++pawns[piece_color(piece)] > 8 || square_rank(square) == 0 || square_rank(square) == 7) { return false; }
+                }
+                if (piece_type(piece) == KING) {
+                    if (kings[piece_color(piece)] != -1) { return false; }
+                    kings[piece_color(piece)] = square;
+                }
+            }
+            if (kings[WHITE] == -1 || kings[BLACK] == -1 || ep_square < NO_SQUARE || ep_square > 63) { return false; }
+
+            memcpy(squares, pieces, sizeof(squares));
+            turn = side;
+            king_square[WHITE] = kings[WHITE];
+            king_square[BLACK] = kings[BLACK];
+            castling = rights & castling_allowed();
+            en_passant = NO_SQUARE;
+            if (ep_square != NO_SQUARE && square_rank(ep_square) == (turn == WHITE ? 5 : 2)) {
+                update_en_passant(ep_square + (turn == WHITE ? -8 : 8));
+            }
+            halfmove_clock = max(0, halfmove);
+            fullmove = max(1, fullmove_number);
+            history.clear();
+            key = compute_key();
+            return true;
+        }
+
+        // Writes the position as a FEN string
+        string fen() {
+            string result;
+            for (int rank = 7; rank >= 0; rank--) {
+                int empty = 0;
+                for (int file = 0; file < 8; file++) {
+                    uint8_t piece = squares[make_square(file, rank)];
+                    if (piece == 0) { empty++; continue; }
+                    if (empty > 0) { result += char('0' + empty); empty = 0; }
+                    char c = " pnbrqk"[piece_type(piece)];
+                    result += piece_color(piece) == WHITE ? toupper(c) : c;
+                }
+                if (empty > 0) { result += char('0' + empty); }
+                if (rank > 0) { result += '/'; }
+            }
+            result += turn == WHITE ? " w " : " b ";
+            string rights;
+            for (int i = 0; i < 4; i++) {
+                if (castling & (1 << i)) { rights += "KQkq"[i]; }
+            }
+            result += rights.empty() ? "-" : rights;
+            if (en_passant == NO_SQUARE) { result += " -"; }
+            else {
+                string name = square_name(en_passant);
+                name[0] = tolower(name[0]);
+                result += " " + name;
+            }
+            result += " " + to_string(halfmove_clock) + " " + to_string(fullmove);
+            return result;
+        }
+
+        // Hash of the whole position, kept up to date incrementally by do_move
+        uint64_t compute_key() {
+            uint64_t k = turn == WHITE ? zobrist.turn : 0;
+            for (int s = 0; s < 64; s++) {
+                if (squares[s] != 0) { k ^= zobrist.pieces[squares[s]][s]; }
+            }
+            k ^= zobrist.castling[castling];
+            if (en_passant != NO_SQUARE) { k ^= zobrist.en_passant[square_file(en_passant)]; }
+            return k;
+        }
+
+        // Checks if the square is attacked by any piece of the given color
+        bool is_attacked(int square, Color by) {
+            int file = square_file(square), rank = square_rank(square);
+            int pawn_rank = by == WHITE ? rank - 1 : rank + 1;
+            if (pawn_rank >= 0 && pawn_rank < 8) {
+                uint8_t pawn = make_piece(PAWN, by);
+                if (file > 0 && squares[make_square(file - 1, pawn_rank)] == pawn) { return true; }
+                if (file < 7 && squares[make_square(file + 1, pawn_rank)] == pawn) { return true; }
+            }
+            uint8_t knight = make_piece(KNIGHT, by);
+            for (int i = 0; i < move_tables.knight_count[square]; i++) {
+                if (squares[move_tables.knight[square][i]] == knight) { return true; }
+            }
+            uint8_t king = make_piece(KING, by);
+            for (int i = 0; i < move_tables.king_count[square]; i++) {
+                if (squares[move_tables.king[square][i]] == king) { return true; }
+            }
+            uint8_t queen = make_piece(QUEEN, by);
+            for (int d = 0; d < 8; d++) {
+                uint8_t slider = make_piece(d < 4 ? ROOK : BISHOP, by);
+                for (int i = 0; i < move_tables.ray_length[square][d]; i++) {
+                    uint8_t piece = squares[move_tables.ray[square][d][i]];
+                    if (piece == 0) { continue; }
+                    if (piece == slider || piece == queen) { return true; }
+                    break;
+                }
+            }
+            return false;
+        }
+
+        // Checks if the side to move is in check
+        bool in_check() { return is_attacked(king_square[turn], (Color)!turn); }
+
+        // Generates every move that follows the movement rules, without checking if the own king is left in check.
+        // Returns the number of moves written to the list, which must hold MAX_MOVES moves. The moves can be
+        // limited to the tactical or the quiet ones, which together are all moves.
+        int generate_pseudo_moves(PackedMove* list, MoveGen gen = GEN_ALL) {
+            int count = 0;
+            for (int from = 0; from < 64; from++) {
+                uint8_t piece = squares[from];
+                if (piece == 0 || piece_color(piece) != turn) { continue; }
+                count = generate_piece_moves(from, list, count, gen);
+            }
+            count_metric(METRIC_MOVES_GENERATED, count);
+            return count;
+        }
+
+        // Generates the moves of the piece on the given square, at most MAX_PIECE_MOVES
+        int generate_piece_moves(int from, PackedMove* list, int count, MoveGen gen = GEN_ALL) {
+            uint8_t piece = squares[from];
+            switch (piece_type(piece)) {
+                case PAWN:
+                    count = generate_pawn_moves(from, list, count, gen);
+                    break;
+                case KNIGHT:
+                    for (int i = 0; i < move_tables.knight_count[from]; i++) {
+                        count = add_move(from, move_tables.knight[from][i], list, count, gen);
+                    }
+                    break;
+                case KING:
+                    for (int i = 0; i < move_tables.king_count[from]; i++) {
+                        count = add_move(from, move_tables.king[from][i], list, count, gen);
+                    }
+                    if (gen != GEN_TACTICAL) { count = generate_castling(from, list, count); }
+                    break;
+                default:
+                    for (int d = piece_type(piece) == BISHOP ? 4 : 0; d < (piece_type(piece) == ROOK ? 4 : 8); d++) {
+                        for (int i = 0; i < move_tables.ray_length[from][d]; i++) {
+                            int to = move_tables.ray[from][d][i];
+                            count = add_move(from, to, list, count, gen);
+                            if (squares[to] != 0) { break; }
+                        }
+                    }
+                    break;
+            }
+            return count;
+        }
+
+        // Checks if a move, e.g. from the hash table or another position, follows the movement rules here
+        bool is_pseudo_legal(PackedMove move) {
+            int from = move_from(move);
+            if (move == NULL_MOVE || squares[from] == 0 || piece_color(squares[from]) != turn) { return false; }
+            PackedMove list[MAX_PIECE_MOVES];
+            int count = generate_piece_moves(from, list, 0);
+            for (int i = 0; i < count; i++) {
+                if (list[i] == move) { return true; }
+            }
+            return false;
+        }
+
+        // Checks if the side to move has any legal move. The moves are generated piece by piece, the king first,
+        // and the search ends at the first legal one, so most positions only generate a few moves.
+        bool has_legal_move() {
+            PackedMove list[MAX_PIECE_MOVES];
+            int count = generate_piece_moves(king_square[turn], list, 0);
+            for (int i = 0; i < count; i++) {
+                if (is_legal(list[i])) { return true; }
+            }
+            for (int from = 0; from < 64; from++) {
+                uint8_t piece = squares[from];
+                if (piece == 0 || piece_color(piece) != turn || from == king_square[turn]) { continue; }
+                count = generate_piece_moves(from, list, 0);
+                for (int i = 0; i < count; i++) {
+                    if (is_legal(list[i])) { return true; }
+                }
+            }
+            return false;
+        }
+
+        // Generates every legal move, returns the number of moves written to the list
+        int generate_moves(PackedMove* list) {
+            PackedMove pseudo[MAX_MOVES];
+            int pseudo_count = generate_pseudo_moves(pseudo);
+            int count = 0;
+            for (int i = 0; i < pseudo_count; i++) {
+                if (is_legal(pseudo[i])) { list[count++] = pseudo[i]; }
+            }
+            return count;
+        }
+
+        // Checks if a pseudo legal move leaves the own king out of check
+        bool is_legal(PackedMove move) {
+            Undo undo;
+            Color mover = turn;
+            do_move(move, undo);
+            bool legal = !is_attacked(king_square[mover], turn);
+            undo_move(move, undo);
+            return legal;
+        }
+
+        // Finds the legal move with the given name (e.g. "e2e4"), returns NULL_MOVE if there is none
+        PackedMove parse_move(string name) {
+            PackedMove list[MAX_MOVES];
+            int count = generate_moves(list);
+            for (auto& c : name) { c = tolower(c); }
+            for (int i = 0; i < count; i++) {
+                if (move_name(list[i]) == name) { return list[i]; }
+            }
+            return NULL_MOVE;
+        }
+
+        // Standard algebraic notation of a legal move, e.g. "Nbd7", "exd6", "e8=Q+" or "O-O-O#"
+        string san(PackedMove move) {
+            int from = move_from(move), to = move_to(move);
+            PieceType type = piece_type(squares[from]);
+            string text;
+            if (is_castling(move)) { text = to > from ? "O-O" : "O-O-O"; }
+            else {
+                bool capture = squares[to] != 0 || is_en_passant(move);
+                if (type == PAWN) {
+                    if (capture) { text += char('a' + square_file(from)); }
+                }
+                else {
+                    text += " PNBRQK"[type];
+                    // Another piece of the same type that can go to the same square needs the file or rank
+                    PackedMove list[MAX_MOVES];
+                    int count = generate_moves(list);
+                    bool ambiguous = false, same_file = false, same_rank = false;
+                    for (int i = 0; i < count; i++) {
+                        int other = move_from(list[i]);
+                        if (move_to(list[i]) != to || other == from || piece_type(squares[other]) != type) { continue; }
+                        ambiguous = true;
+                        if (square_file(other) == square_file(from)) { same_file = true; }
+                        if (square_rank(other) == square_rank(from)) { same_rank = true; }
+                    }
+                    if (ambiguous && (!same_file || same_rank)) { text += char('a' + square_file(from)); }
+                    if (ambiguous && same_file) { text += char('1' + square_rank(from)); }
+                }
+                if (capture) { text += 'x'; }
+                text += char('a' + square_file(to));
+                text += char('1' + square_rank(to));
+                if (move_promotion(move) != NO_PIECE_TYPE) { text += string("=") + " PNBRQK"[move_promotion(move)]; }
+            }
+            Undo undo;
+            do_move(move, undo);
+            if (in_check()) {
+                PackedMove list[MAX_MOVES];
+                text += generate_moves(list) > 0 ? "+" : "#";
+            }
+            undo_move(move, undo);
+            return text;
+        }
+
+        // Finds the legal move written in standard algebraic notation, returns NULL_MOVE if there is none or
+        // it is ambiguous. Check marks and annotations are ignored, and "0-0" and "e8Q" are accepted too.
+        PackedMove parse_san(string text) {
+            while (!text.empty() && strchr("+#!?", text.back())) { text.pop_back(); }
+            PackedMove list[MAX_MOVES];
+            int count = generate_moves(list);
+            if (text == "O-O" || text == "0-0" || text == "O-O-O" || text == "0-0-0") {
+                for (int i = 0; i < count; i++) {
+                    if (is_castling(list[i]) && (move_to(list[i]) > move_from(list[i])) == (text.length() == 3)) { return list[i]; }
+                }
+                return NULL_MOVE;
+            }
+            PieceType promotion = NO_PIECE_TYPE;
+            if (text.length() > 2 && strchr("NBRQ", text.back())) {
+                promotion = (PieceType)(strchr(" PNBRQK", text.back()) - " PNBRQK");
+                text.pop_back();
+                if (text.back() == '=') { text.pop_back(); }
+            }
+            if (text.length() < 2) { return NULL_MOVE; }
+            int to = parse_square(text.substr(text.length() - 2));
+            if (to == NO_SQUARE) { return NULL_MOVE; }
+            PieceType type = PAWN;
+            size_t start = 0;
+            if (strchr("NBRQK", text[0])) {
+                type = (PieceType)(strchr(" PNBRQK", text[0]) - " PNBRQK");
+                start = 1;
+            }
+            int file = -1, rank = -1; // Given to tell pieces apart
+            for (size_t i = start; i + 2 < text.length(); i++) {
+                if (text[i] >= 'a' && text[i] <= 'h') { file = text[i] - 'a'; }
+                else if (text[i] >= '1' && text[i] <= '8') { rank = text[i] - '1'; }
+                else if (text[i] != 'x' && text[i] != '-') { return NULL_MOVE; }
+            }
+            PackedMove found = NULL_MOVE;
+            for (int i = 0; i < count; i++) {
+                int from = move_from(list[i]);
+                if (move_to(list[i]) != to || piece_type(squares[from]) != type || move_promotion(list[i]) != promotion) { continue; }
+                if ((file != -1 && square_file(from) != file) || (rank != -1 && square_rank(from) != rank)) { continue; }
+                if (found != NULL_MOVE) { return NULL_MOVE; }
+                found = list[i];
+            }
+            return found;
+        }
+
+        // Castling is a king move of two files, and en passant a pawn capture to the en passant square
+        bool is_castling(PackedMove move) {
+            return piece_type(squares[move_from(move)]) == KING && abs(move_from(move) - move_to(move)) == 2;
+        }
+        bool is_en_passant(PackedMove move) {
+            return move_to(move) == en_passant && piece_type(squares[move_from(move)]) == PAWN;
+        }
+
+        void do_move(PackedMove move, Undo& undo) {
+            int from = move_from(move), to = move_to(move);
+            uint8_t piece = squares[from];
+            undo.captured = squares[to];
+            undo.castling = castling;
+            undo.en_passant = en_passant;
+            undo.halfmove_clock = halfmove_clock;
+            undo.key = key;
+            history.push_back(key);
+
+            if (piece_type(piece) == PAWN || undo.captured != 0) { halfmove_clock = 0; }
+            else { halfmove_clock++; }
+            if (turn == BLACK) { fullmove++; }
+
+            if (is_en_passant(move)) { // The captured pawn is behind the en passant square
+                int captured_square = to + (turn == WHITE ? -8 : 8);
+                key ^= zobrist.pieces[squares[captured_square]][captured_square];
+                squares[captured_square] = 0;
+            }
+            else if (is_castling(move)) { // Move the rook to the other side of the king
+                int rook_from = to > from ? from + 3 : from - 4;
+                int rook_to = to > from ? from + 1 : from - 1;
+                key ^= zobrist.pieces[squares[rook_from]][rook_from] ^ zobrist.pieces[squares[rook_from]][rook_to];
+                squares[rook_to] = squares[rook_from];
+                squares[rook_from] = 0;
+            }
+
+            if (undo.captured != 0) { key ^= zobrist.pieces[undo.captured][to]; }
+            key ^= zobrist.pieces[piece][from];
+            if (move_promotion(move) != NO_PIECE_TYPE) { piece = make_piece(move_promotion(move), turn); }
+            key ^= zobrist.pieces[piece][to];
+            squares[to] = piece;
+            squares[from] = 0;
+            if (piece_type(piece) == KING) { king_square[turn] = to; }
+
+            key ^= zobrist.castling[castling];
+            castling &= move_tables.castling_mask[from] & move_tables.castling_mask[to];
+            key ^= zobrist.castling[castling];
+            if (en_passant != NO_SQUARE) { key ^= zobrist.en_passant[square_file(en_passant)]; }
+            en_passant = NO_SQUARE;
+            turn = (Color)!turn;
+            key ^= zobrist.turn;
+            if (piece_type(piece) == PAWN && abs(to - from) == 16) { update_en_passant(to); }
+        }
+
+        void undo_move(PackedMove move, Undo& undo) {
+            int from = move_from(move), to = move_to(move);
+            turn = (Color)!turn;
+            uint8_t piece = squares[to];
+            if (move_promotion(move) != NO_PIECE_TYPE) { piece = make_piece(PAWN, turn); }
+            squares[from] = piece;
+            squares[to] = undo.captured;
+            if (piece_type(piece) == KING) { king_square[turn] = from; }
+            if (piece_type(piece) == PAWN && to == undo.en_passant) {
+                squares[to + (turn == WHITE ? -8 : 8)] = make_piece(PAWN, (Color)!turn);
+            }
+            else if (piece_type(piece) == KING && abs(to - from) == 2) {
+                int rook_from = to > from ? from + 3 : from - 4;
+                int rook_to = to > from ? from + 1 : from - 1;
+                squares[rook_from] = squares[rook_to];
+                squares[rook_to] = 0;
+            }
+            if (turn == BLACK) { fullmove--; }
+            castling = undo.castling;
+            en_passant = undo.en_passant;
+            halfmove_clock = undo.halfmove_clock;
+            key = undo.key;
+            history.pop_back();
+        }
+
+        // Counts how often the current position occurred before. Only positions with the same side to move
+        // since the last capture or pawn move can be equal, so at most halfmove_clock / 2 keys are compared.
+        int repetitions() {
+            int count = 0;
+            int n = history.size();
+            int limit = max(0, n - (int)halfmove_clock);
+            for (int i = n - 2; i >= limit; i -= 2) {
+                if (history[i] == key) { count++; }
+            }
+            return count;
+        }
+
+        // Draw by the fifty move rule or threefold repetition
+        bool is_draw() {
+            return halfmove_clock >= 100 || repetitions() >= 2;
+        }
+
+        // State of the position for the side to move, using the same states as the board
+        State state() {
+            bool check = in_check();
+            bool valid_move = has_legal_move();
+            if (!valid_move && !check) { return TIE; }
+            if (valid_move && is_draw()) { return TIE; }
+            if (turn == WHITE) {
+                if (check) { return valid_move ? WHITE_CHECK : WHITE_CHECKMATE; }
+            }
+            else if (check) { return valid_move ? BLACK_CHECK : BLACK_CHECKMATE; }
+            return NEUTRAL;
+        }
+
+        // Counts the leaf nodes of the legal move tree, used to verify the move generation
+        uint64_t perft(int depth) {
+            PackedMove list[MAX_MOVES];
+            int count = generate_moves(list);
+            if (depth <= 1) { return depth == 1 ? count : 1; }
+            uint64_t nodes = 0;
+            for (int i = 0; i < count; i++) {
+                Undo undo;
+                do_move(list[i], undo);
+                nodes += perft(depth - 1);
+                undo_move(list[i], undo);
+            }
+            return nodes;
+        }
+
+    private:
+        // Castling rights that are possible with the kings and rooks on their start squares
+        int castling_allowed() {
+            int allowed = 0;
+            if (squares[make_square(4, 0)] == make_piece(KING, WHITE)) {
+                if (squares[make_square(7, 0)] == make_piece(ROOK, WHITE)) { allowed |= WHITE_KING_SIDE; }
+                if (squares[make_square(0, 0)] == make_piece(ROOK, WHITE)) { allowed |= WHITE_QUEEN_SIDE; }
+            }
+            if (squares[make_square(4, 7)] == make_piece(KING, BLACK)) {
+                if (squares[make_square(7, 7)] == make_piece(ROOK, BLACK)) { allowed |= BLACK_KING_SIDE; }
+                if (squares[make_square(0, 7)] == make_piece(ROOK, BLACK)) { allowed |= BLACK_QUEEN_SIDE; }
+            }
+            return allowed;
+        }
+
+        // Sets the en passant square behind a pawn that moved two fields, if the side to move has a pawn
+        // next to it. Otherwise the square can't be used, and leaving it out keeps repeated positions equal.
+        void update_en_passant(int pawn_square) {
+            int file = square_file(pawn_square);
+            uint8_t pawn = make_piece(PAWN, turn);
+            if ((file > 0 && squares[pawn_square - 1] == pawn) || (file < 7 && squares[pawn_square + 1] == pawn)) {
+                en_passant = pawn_square + (turn == WHITE ? 8 : -8);
+                key ^= zobrist.en_passant[file];
+            }
+        }
+
+        // Adds castling moves, the king may not castle out of, through or into check
+        int generate_castling(int from, PackedMove* list, int count) {
+            int rights = castling & (turn == WHITE ? WHITE_KING_SIDE | WHITE_QUEEN_SIDE : BLACK_KING_SIDE | BLACK_QUEEN_SIDE);
+            if (rights == 0 || is_attacked(from, (Color)!turn)) { return count; }
+            if ((rights & (WHITE_KING_SIDE | BLACK_KING_SIDE)) && squares[from + 1] == 0 && squares[from + 2] == 0 &&
+                !is_attacked(from + 1, (Color)!turn)) {
+                list[count++] = make_move(from, from + 2);
+            }
+            if ((rights & (WHITE_QUEEN_SIDE | BLACK_QUEEN_SIDE)) && squares[from - 1] == 0 && squares[from - 2] == 0 &&
+                squares[from - 3] == 0 && !is_attacked(from - 1, (Color)!turn)) {
+                list[count++] = make_move(from, from - 2);
+            }
+            return count;
+        }
+
+        // Adds a move to an empty square or a capture of an opponent piece
+        int add_move(int from, int to, PackedMove* list, int count, MoveGen gen) {
+            if (squares[to] == 0) {
+                if (gen != GEN_TACTICAL) { list[count++] = make_move(from, to); }
+            }
+            else if (piece_color(squares[to]) != turn && gen != GEN_QUIET) { list[count++] = make_move(from, to); }
+            return count;
+        }
+
+        // Adds a pawn move, which becomes four moves when it reaches the last rank.
+        // Captures and queen promotions are tactical, pushes and the other promotions quiet.
+        int add_pawn_move(int from, int to, bool capture, PackedMove* list, int count, MoveGen gen) {
+            bool tactical = gen != GEN_QUIET, quiet = gen != GEN_TACTICAL;
+            if (square_rank(to) == 0 || square_rank(to) == 7) {
+                if (tactical) { list[count++] = make_move(from, to, QUEEN); }
+                if (capture ? tactical : quiet) {
+                    list[count++] = make_move(from, to, ROOK);
+                    list[count++] = make_move(from, to, BISHOP);
+                    list[count++] = make_move(from, to, KNIGHT);
+                }
+            }
+            else if (capture ? tactical : quiet) { list[count++] = make_move(from, to); }
+            return count;
+        }
+
+        int generate_pawn_moves(int from, PackedMove* list, int count, MoveGen gen) {
+            int forward = turn == WHITE ? 8 : -8;
+            int start_rank = turn == WHITE ? 1 : 6;
+            int file = square_file(from);
+            int to = from + forward;
+            if (to < 0 || to > 63) { return count; }
+            if (squares[to] == 0) {
+                count = add_pawn_move(from, to, false, list, count, gen);
+                if (square_rank(from) == start_rank && squares[to + forward] == 0 && gen != GEN_TACTICAL) {
+                    list[count++] = make_move(from, to + forward);
+                }
+            }
+            if (file > 0 && ((squares[to - 1] != 0 && piece_color(squares[to - 1]) != turn) || to - 1 == en_passant)) {
+                count = add_pawn_move(from, to - 1, true, list, count, gen);
+            }
+            if (file < 7 && ((squares[to + 1] != 0 && piece_color(squares[to + 1]) != turn) || to + 1 == en_passant)) {
+                count = add_pawn_move(from, to + 1, true, list, count, gen);
+            }
+            return count;
+        }
+};
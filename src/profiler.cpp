@@ -0,0 +1,206 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <SDL2/SDL.h>
+
+using namespace std;
+
+#define PROFILER_HISTORY 240 // Frames kept for the percentile overlay, 2 seconds at 120 FPS
+#define PROFILER_MAX_EVENTS 2000000 // Upper bound for the trace buffer, roughly 64MB
+
+// A timed scope, stored the same way as a chrome "complete" trace event
+typedef struct {
+    const char* name;
+    Uint64 start;
+    Uint64 end;
+} ProfileEvent;
+
+// Per-frame durations of a single phase, kept in a ring buffer
+typedef struct {
+    const char* name;
+    bool idle;
+    double current;
+    vector<double> history;
+} ProfilePhase;
+
+// Collects scoped timings for every frame, keeps a short history for the overlay,
+// and optionally stores every event so it can be dumped as a chrome trace_event file
+class Profiler {
+    private:
+        Uint64 frequency;
+        Uint64 origin;
+        Uint64 frame_start;
+        int frame_count;
+        vector<double> frame_times;
+        vector<double> busy_times;
+        vector<ProfilePhase> phases;
+        vector<ProfileEvent> events;
+        string trace_path;
+        Uint64 last_overlay_update;
+        vector<string> overlay_lines;
+
+        // Converts performance counter ticks to milliseconds
+        double to_ms(Uint64 ticks) { return ticks * 1000.0 / frequency; }
+
+        // Finds the phase by name, names are string literals so the pointer is the key
+        ProfilePhase& phase(const char* name, bool idle) {
+            for (auto& p : phases) {
+                if (p.name == name) { return p; }
+            }
+            phases.push_back({ name, idle, 0.0, vector<double>(PROFILER_HISTORY, 0.0) });
+            return phases.back();
+        }
+
+        // Returns the given percentile (0-100) of the values
+        static double percentile(vector<double> values, double p) {
+            if (values.empty()) { return 0.0; }
+            int n = (values.size() - 1) * p / 100.0;
+            nth_element(values.begin(), values.begin() + n, values.end());
+            return values[n];
+        }
+
+        // Values recorded so far, the ring buffer is only partially filled in the first frames
+        vector<double> recorded(const vector<double>& ring) {
+            int n = min(frame_count, PROFILER_HISTORY);
+            return vector<double>(ring.begin(), ring.begin() + n);
+        }
+
+        void update_overlay() {
+            char line[128];
+            vector<double> frames = recorded(frame_times);
+            vector<double> busy = recorded(busy_times);
+            overlay_lines.clear();
+            overlay_lines.push_back("ms                         p50    p90    p99    max");
+            snprintf(line, sizeof(line), "%-22s %6.2f %6.2f %6.2f %6.2f", "frame",
+                percentile(frames, 50), percentile(frames, 90), percentile(frames, 99), percentile(frames, 100));
+            overlay_lines.push_back(line);
+            snprintf(line, sizeof(line), "%-22s %6.2f %6.2f %6.2f %6.2f", "busy",
+                percentile(busy, 50), percentile(busy, 90), percentile(busy, 99), percentile(busy, 100));
+            overlay_lines.push_back(line);
+            for (auto& p : phases) {
+                vector<double> values = recorded(p.history);
+                snprintf(line, sizeof(line), "%-22.22s %6.2f %6.2f %6.2f %6.2f", p.name,
+                    percentile(values, 50), percentile(values, 90), percentile(values, 99), percentile(values, 100));
+                overlay_lines.push_back(line);
+            }
+        }
+
+    public:
+        Profiler() {
+            frequency = SDL_GetPerformanceFrequency();
+            origin = SDL_GetPerformanceCounter();
+            frame_start = origin;
+            frame_count = 0;
+            frame_times.assign(PROFILER_HISTORY, 0.0);
+            busy_times.assign(PROFILER_HISTORY, 0.0);
+            last_overlay_update = 0;
+            overlay = false;
+        }
+
+        bool overlay;
+
+        // Enables recording of all events, which are written to the given path by write_trace()
+        void enable_trace(string path) {
+            trace_path = path;
+            events.reserve(1 << 16);
+        }
+        bool is_tracing() { return !trace_path.empty(); }
+
+        // Called first in every iteration of the main loop
+        void begin_frame() {
+            frame_start = SDL_GetPerformanceCounter();
+            for (auto& p : phases) { p.current = 0.0; }
+        }
+
+        // Called last in every iteration of the main loop
+        void end_frame() {
+            Uint64 now = SDL_GetPerformanceCounter();
+            double frame_time = to_ms(now - frame_start);
+            double idle_time = 0.0;
+            int index = frame_count % PROFILER_HISTORY;
+            for (auto& p : phases) {
+                p.history[index] = p.current;
+                if (p.idle) { idle_time += p.current; }
+            }
+            frame_times[index] = frame_time;
+            busy_times[index] = frame_time - idle_time;
+            frame_count++;
+            if (is_tracing()) { record_event("frame", frame_start, now); }
+
+            // Refresh the overlay text four times a second, so the numbers stay readable
+            if (overlay && to_ms(now - last_overlay_update) > 250) {
+                update_overlay();
+                last_overlay_update = now;
+            }
+        }
+
+        // Adds a finished scope to the current frame
+        void record(const char* name, Uint64 start, Uint64 end, bool idle) {
+            phase(name, idle).current += to_ms(end - start);
+            if (is_tracing()) { record_event(name, start, end); }
+        }
+
+        void record_event(const char* name, Uint64 start, Uint64 end) {
+            if (events.size() < PROFILER_MAX_EVENTS) {
+                events.push_back({ name, start, end });
+            }
+        }
+
+        vector<string> getOverlayLines() { return overlay_lines; }
+
+        // Writes all recorded events as a chrome trace_event JSON file (chrome://tracing, ui.perfetto.dev)
+        bool write_trace() {
+            if (!is_tracing()) { return false; }
+            ofstream file(trace_path);
+            if (!file) {
+                cout << "Cannot write trace file: " << trace_path << endl;
+                return false;
+            }
+            file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            char line[256];
+            for (size_t i = 0; i < events.size(); i++) {
+                ProfileEvent& e = events[i];
+                snprintf(line, sizeof(line),
+                    "{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+                    e.name, to_ms(e.start - origin) * 1000.0, to_ms(e.end - e.start) * 1000.0,
+                    i + 1 < events.size() ? "," : "");
+                file << line;
+            }
+            file << "]}\n";
+            if (events.size() >= PROFILER_MAX_EVENTS) {
+                cout << "Trace buffer was full, only the first " << PROFILER_MAX_EVENTS << " events were written\n";
+            }
+            return true;
+        }
+};
+
+Profiler profiler;
+
+// Times the enclosing scope and reports it to the profiler when it goes out of scope.
+// Idle scopes (like sleeping for the frame target) are excluded from the busy time.
+class ScopedTimer {
+    private:
+        const char* name;
+        bool idle;
+        Uint64 start;
+
+    public:
+        ScopedTimer(const char* name, bool idle = false) {
+            this->name = name;
+            this->idle = idle;
+            this->start = SDL_GetPerformanceCounter();
+        }
+
+        ~ScopedTimer() {
+            profiler.record(name, start, SDL_GetPerformanceCounter(), idle);
+        }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_CONCAT(scoped_timer_, __LINE__)(name)
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include <search.cpp>
+
+using namespace std;
+
+#define REVIEW_HASH_MB 256
+#define REVIEW_TIME_MS 500 // Search time for every position of the game
+#define REVIEW_CLAMP_CP 1000 // Scores beyond this count as won, so a won game that stays won has no mistakes
+#define REVIEW_INACCURACY_CP 50 // Evaluation drops of a move, from the view of its player
+#define REVIEW_MISTAKE_CP 100
+#define REVIEW_BLUNDER_CP 200
+
+enum MoveMark { MARK_PENDING, MARK_GOOD, MARK_INACCURACY, MARK_MISTAKE, MARK_BLUNDER };
+
+typedef struct {
+    MoveMark mark;
+    int drop; // Centipawns the move lost against the best move
+    PackedMove best; // Best move found in the position before the move
+} MoveReview;
+
+// Reviews a whole game. Every position of the game is searched at the same time on all cores, sharing one
+// transposition table, so neighbouring positions reuse each other's results. A move is marked as soon as the
+// positions before and after it are both searched, by how much the evaluation dropped for the player who made it.
+class GameReview {
+    private:
+        TranspositionTable tt;
+        vector<thread> workers;
+        vector<unique_ptr<Search>> searches;
+        mutex lock;
+        vector<Position> positions; // Before every move, and after the last one
+        vector<int> scores; // For the side to move of each position
+        vector<bool> searched;
+        vector<MoveReview> moves;
+        atomic<int> next;
+        atomic<int> working; // Workers that haven't finished yet
+        atomic<bool> cancelled;
+        bool allocated = false; // The table only gets its memory on the first review
+        int version = 0;
+
+        // Score of the side to move, limited so only drops that change the outcome count in a won position
+        static int clamped(int score) {
+            if (abs(score) >= MATE_BOUND) { return score > 0 ? REVIEW_CLAMP_CP : -REVIEW_CLAMP_CP; }
+            return max(-REVIEW_CLAMP_CP, min(REVIEW_CLAMP_CP, score));
+        }
+
+        // Marks the move once both its positions are searched, the caller holds the lock
+        void mark_move(int i) {
+            if (i < 0 || i >= (int)moves.size() || !searched[i] || !searched[i + 1]) { return; }
+            int drop = max(0, clamped(scores[i]) + clamped(scores[i + 1])); // The score after is the opponent's
+            moves[i].drop = drop;
+            moves[i].mark = drop >= REVIEW_BLUNDER_CP ? MARK_BLUNDER : drop >= REVIEW_MISTAKE_CP ? MARK_MISTAKE :
+                drop >= REVIEW_INACCURACY_CP ? MARK_INACCURACY : MARK_GOOD;
+        }
+
+        void work(Search& search) {
+            SearchLimits limits = { 0, 1, 0, REVIEW_TIME_MS, false };
+            for (int i = next++; i < (int)positions.size(); i = next++) {
+                vector<SearchLine> lines = search.run(positions[i], limits);
+                if (cancelled) { break; }
+                lock_guard<mutex> guard(lock);
+                if (lines.empty()) { scores[i] = positions[i].in_check() ? -MATE_SCORE : 0; } // Mate or stalemate
+                else {
+                    scores[i] = lines[0].score;
+                    if (i < (int)moves.size()) { moves[i].best = lines[0].pv[0]; }
+                }
+                searched[i] = true;
+                mark_move(i - 1);
+                mark_move(i);
+                version++;
+            }
+            working--;
+        }
+
+    public:
+        GameReview() : tt(0) {
+            next = 0;
+            working = 0;
+            cancelled = false;
+        }
+        ~GameReview() { cancel(); }
+
+        bool is_running() { return working > 0; }
+
+        // Starts reviewing the game played from the start position, replacing an earlier review
+        void start(const vector<PackedMove>& game) {
+            cancel();
+            Position position;
+            positions.clear();
+            for (PackedMove move : game) {
+                positions.push_back(position);
+                Undo undo;
+                position.do_move(move, undo);
+            }
+            positions.push_back(position);
+            scores.assign(positions.size(), 0);
+            searched.assign(positions.size(), false);
+            moves.assign(game.size(), { MARK_PENDING, 0, NULL_MOVE });
+            if (allocated) { tt.clear(); }
+            else {
+                tt.resize(REVIEW_HASH_MB);
+                allocated = true;
+            }
+            next = 0;
+            cancelled = false;
+            int threads = min((int)positions.size(), max(1, (int)thread::hardware_concurrency()));
+            while ((int)searches.size() < threads) { searches.push_back(make_unique<Search>(tt)); }
+            working = threads;
+            for (int i = 0; i < threads; i++) {
+                searches[i]->stop = false;
+                workers.emplace_back(&GameReview::work, this, ref(*searches[i]));
+            }
+            version++;
+        }
+
+        // Stops the review and drops its results
+        void cancel() {
+            cancelled = true;
+            for (auto& search : searches) { search->stop = true; }
+            for (auto& w : workers) { w.join(); }
+            workers.clear();
+            lock_guard<mutex> guard(lock);
+            moves.clear();
+            version++;
+        }
+
+        // Copies the marks of the moves if they changed since the given version, returns false otherwise
+        bool poll(vector<MoveReview>& out, int& seen_version) {
+            lock_guard<mutex> guard(lock);
+            if (seen_version == version) { return false; }
+            out = moves;
+            seen_version = version;
+            return true;
+        }
+};
@@ -0,0 +1,501 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+
+#include <position.cpp>
+#include <eval.cpp>
+#include <clock.cpp>
+#include <bitbase.cpp>
+
+using namespace std;
+
+// Alpha-beta search with iterative deepening and multiple principal variations
+
+#define MAX_PLY 64
+#define INFINITE_SCORE 32000
+#define MATE_SCORE 31000
+#define MATE_BOUND (MATE_SCORE - MAX_PLY) // Scores above this are mates, counted in plies from the root
+#define SEARCH_CHECK_NODES 2048 // Nodes between checks of the stop flag and the limits
+
+enum Bound { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+// A search result as it is read from and written to the table
+typedef struct {
+    uint64_t key;
+    PackedMove move;
+    int16_t score;
+    int8_t depth;
+    uint8_t bound;
+    uint8_t age;
+} TTEntry;
+
+// 16 bytes, so four slots share a cache line. The first word is the key xor the data, so a slot that two
+// threads wrote at the same time no longer matches its key and is a miss instead of a wrong result.
+typedef struct {
+    atomic<uint64_t> check;
+    atomic<uint64_t> data;
+} TTSlot;
+
+// Hash table of search results, kept between searches so revisiting a position reuses the earlier work.
+// Searches on several threads may share one table, the slots are read and written without locks.
+class TranspositionTable {
+    private:
+        vector<TTSlot> slots;
+        uint64_t mask;
+        atomic<uint8_t> age;
+
+        static uint64_t pack(const TTEntry& entry) {
+            return entry.move | (uint64_t)(uint16_t)entry.score << 16 | (uint64_t)(uint8_t)entry.depth << 32 |
+                (uint64_t)entry.bound << 40 | (uint64_t)entry.age << 48;
+        }
+
+        static TTEntry unpack(uint64_t key, uint64_t data) {
+            return { key, (PackedMove)data, (int16_t)(data >> 16), (int8_t)(data >> 32), (uint8_t)(data >> 40),
+                (uint8_t)(data >> 48) };
+        }
+
+    public:
+        TranspositionTable(int megabytes = 16) { resize(megabytes); }
+
+        // Resizes the table to the largest power of two slots that fits, which clears it
+        void resize(int megabytes) {
+            uint64_t count = 1;
+            while (count * 2 * sizeof(TTSlot) <= (uint64_t)megabytes << 20) { count *= 2; }
+            slots = vector<TTSlot>(count);
+            mask = count - 1;
+            age = 0;
+            clear();
+        }
+
+        void clear() {
+            for (auto& slot : slots) {
+                slot.check.store(0, memory_order_relaxed);
+                slot.data.store(0, memory_order_relaxed);
+            }
+        }
+
+        // Called before every search, so entries of earlier searches are replaced first
+        void new_search() { age++; }
+
+        bool probe(uint64_t key, TTEntry& entry) {
+            TTSlot& slot = slots[key & mask];
+            uint64_t data = slot.data.load(memory_order_relaxed);
+            uint64_t stored = slot.check.load(memory_order_relaxed) ^ data;
+            entry = unpack(stored, data);
+            bool hit = stored == key && entry.bound != BOUND_NONE;
+            count_metric(METRIC_TT_PROBES);
+            if (hit) { count_metric(METRIC_TT_HITS); }
+            return hit;
+        }
+
+        // Keeps the deeper result for the same position, and always replaces entries of earlier searches
+        void store(uint64_t key, PackedMove move, int score, int depth, Bound bound) {
+            TTSlot& slot = slots[key & mask];
+            uint64_t data = slot.data.load(memory_order_relaxed);
+            TTEntry entry = unpack(slot.check.load(memory_order_relaxed) ^ data, data);
+            uint8_t current = age;
+            if (entry.key == key && entry.age == current && depth < entry.depth && bound != BOUND_EXACT) { return; }
+            if (entry.key != key && entry.age == current && depth < entry.depth - 2) { return; }
+            if (move == NULL_MOVE && entry.key == key) { move = entry.move; }
+            data = pack({ key, move, (int16_t)score, (int8_t)depth, (uint8_t)bound, current });
+            slot.check.store(key ^ data, memory_order_relaxed);
+            slot.data.store(data, memory_order_relaxed);
+        }
+
+        // Permille of a sample of entries that were written by the current search
+        int hashfull() {
+            int used = 0;
+            for (int i = 0; i < 1000 && i < (int)slots.size(); i++) {
+                TTEntry entry = unpack(0, slots[i].data.load(memory_order_relaxed));
+                if (entry.bound != BOUND_NONE && entry.age == age) { used++; }
+            }
+            return used;
+        }
+};
+
+// Mate scores are stored relative to the position instead of the root
+inline int score_to_tt(int score, int ply) {
+    return score >= MATE_BOUND ? score + ply : score <= -MATE_BOUND ? score - ply : score;
+}
+inline int score_from_tt(int score, int ply) {
+    return score >= MATE_BOUND ? score - ply : score <= -MATE_BOUND ? score + ply : score;
+}
+
+// Hands out the pseudo legal moves of a position one at a time, in the order they are most likely to be best:
+// the hash move, captures by the most valuable victim and the least valuable attacker, the killer moves and
+// then the quiet moves. Each stage is only generated when the one before is used up, so a cutoff by an early
+// move skips the rest of the generation. The moves are kept in a buffer inside the picker, on the stack.
+enum PickStage { PICK_HASH, PICK_TACTICAL_INIT, PICK_TACTICAL, PICK_KILLERS, PICK_QUIET_INIT, PICK_QUIET, PICK_DONE };
+
+class MovePicker {
+    private:
+        Position& position;
+        PackedMove hash_move;
+        PackedMove killers[2];
+        bool quiet_moves;
+        int stage;
+        PackedMove moves[MAX_MOVES];
+        int scores[MAX_MOVES];
+        int count = 0;
+        int index = 0;
+
+        // Promotions add to the capture order, so a capture that promotes comes before one that doesn't
+        int capture_order(PackedMove move) {
+            uint8_t victim = position.squares[move_to(move)];
+            int score = 0;
+            if (victim != 0) { score = piece_type(victim) * 16 - piece_type(position.squares[move_from(move)]); }
+            else if (position.is_en_passant(move)) { score = PAWN * 16 - PAWN; }
+            return score + move_promotion(move) * 256;
+        }
+
+        bool is_quiet(PackedMove move) {
+            return position.squares[move_to(move)] == 0 && !position.is_en_passant(move) && move_promotion(move) != QUEEN;
+        }
+
+    public:
+        // Without the quiet moves only the tactical moves are picked, as in the quiescence search
+        MovePicker(Position& position, PackedMove hash_move, const PackedMove* killers, bool quiet_moves = true)
+            : position(position), quiet_moves(quiet_moves) {
+            // Moves from the hash table or another node are only used if they can be played here
+            bool hash_usable = position.is_pseudo_legal(hash_move) && (quiet_moves || !is_quiet(hash_move));
+            this->hash_move = hash_usable ? hash_move : NULL_MOVE;
+            for (int i = 0; i < 2; i++) {
+                PackedMove killer = killers != NULL && quiet_moves ? killers[i] : NULL_MOVE;
+                bool usable = killer != this->hash_move && (i == 0 || killer != this->killers[0]) &&
+                    is_quiet(killer) && position.is_pseudo_legal(killer);
+                this->killers[i] = usable ? killer : NULL_MOVE;
+            }
+            stage = this->hash_move != NULL_MOVE ? PICK_HASH : PICK_TACTICAL_INIT;
+        }
+
+        // The next move, or NULL_MOVE when all moves were picked
+        PackedMove next() {
+            switch (stage) {
+                case PICK_HASH:
+                    stage = PICK_TACTICAL_INIT;
+                    return hash_move;
+                case PICK_TACTICAL_INIT:
+                    count = position.generate_pseudo_moves(moves, GEN_TACTICAL);
+                    for (int i = 0; i < count; i++) { scores[i] = capture_order(moves[i]); }
+                    index = 0;
+                    stage = PICK_TACTICAL;
+                    [[fallthrough]];
+                case PICK_TACTICAL:
+                    while (index < count) { // Selection of the best remaining move, most nodes only use one or two
+                        int best = index;
+                        for (int i = index + 1; i < count; i++) {
+                            if (scores[i] > scores[best]) { best = i; }
+                        }
+                        swap(moves[index], moves[best]);
+                        swap(scores[index], scores[best]);
+                        PackedMove move = moves[index++];
+                        if (move != hash_move) { return move; }
+                    }
+                    if (!quiet_moves) {
+                        stage = PICK_DONE;
+                        return NULL_MOVE;
+                    }
+                    stage = PICK_KILLERS;
+                    index = 0;
+                    [[fallthrough]];
+                case PICK_KILLERS:
+                    while (index < 2) {
+                        PackedMove killer = killers[index++];
+                        if (killer != NULL_MOVE) { return killer; }
+                    }
+                    stage = PICK_QUIET_INIT;
+                    [[fallthrough]];
+                case PICK_QUIET_INIT:
+                    count = position.generate_pseudo_moves(moves, GEN_QUIET);
+                    index = 0;
+                    stage = PICK_QUIET;
+                    [[fallthrough]];
+                case PICK_QUIET:
+                    while (index < count) {
+                        PackedMove move = moves[index++];
+                        if (move != hash_move && move != killers[0] && move != killers[1]) { return move; }
+                    }
+                    stage = PICK_DONE;
+                    [[fallthrough]];
+                default:
+                    return NULL_MOVE;
+            }
+        }
+};
+
+// Limits of a search, 0 means no limit
+typedef struct {
+    int depth;
+    int multipv;
+    uint64_t nodes;
+    int time_ms;
+    bool ponder; // Searching on the opponent's time, the time limit is only set later with set_deadline()
+} SearchLimits;
+
+// One principal variation, the score is from the view of the side to move in the searched position
+typedef struct {
+    int depth;
+    int score;
+    uint64_t nodes;
+    int time_ms;
+    vector<PackedMove> pv;
+} SearchLine;
+
+class Search {
+    private:
+        TranspositionTable& tt;
+        Position position;
+        SearchLimits limits;
+        chrono::steady_clock::time_point start;
+        atomic<int64_t> deadline_us; // Time of clock_now_us() the search stops at, 0 for none
+        uint64_t nodes;
+        uint64_t counted_nodes; // Nodes already added to the metrics
+        PackedMove pv[MAX_PLY + 1][MAX_PLY + 1];
+        int pv_length[MAX_PLY + 1];
+        PackedMove killers[MAX_PLY + 1][2];
+        vector<PackedMove> root_moves;
+        bool aborted; // Set when the search was stopped, every result after that is discarded
+        int completed_depth;
+
+        int elapsed_ms() {
+            return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+        }
+
+        void count_nodes() {
+            count_metric(METRIC_SEARCH_NODES, nodes - counted_nodes);
+            counted_nodes = nodes;
+        }
+
+        // Checks the node limit, and every few thousand nodes the stop flag and the time. The limits only
+        // apply once the first depth is finished, so a limited search always has a move.
+        bool should_stop() {
+            if (aborted) { return true; }
+            nodes++;
+            if (limits.nodes && nodes >= limits.nodes && completed_depth > 0) { aborted = true; }
+            else if (nodes % SEARCH_CHECK_NODES == 0) {
+                count_nodes();
+                int64_t deadline = deadline_us;
+                aborted = stop || (deadline && clock_now_us() >= deadline && completed_depth > 0);
+            }
+            return aborted;
+        }
+
+        // Plays the move, and takes it back again if it leaves the own king in check
+        bool make_legal_move(PackedMove move, Undo& undo) {
+            Color mover = position.turn;
+            position.do_move(move, undo);
+            if (position.is_attacked(position.king_square[mover], position.turn)) {
+                position.undo_move(move, undo);
+                return false;
+            }
+            return true;
+        }
+
+        // Quiet moves that caused a cutoff are tried early in the other nodes of the same ply
+        void update_killers(int ply, PackedMove move) {
+            if (position.squares[move_to(move)] != 0 || position.is_en_passant(move) || move_promotion(move) == QUEEN) { return; }
+            if (killers[ply][0] != move) {
+                killers[ply][1] = killers[ply][0];
+                killers[ply][0] = move;
+            }
+        }
+
+        void update_pv(int ply, PackedMove move) {
+            pv[ply][0] = move;
+            for (int i = 0; i < pv_length[ply + 1]; i++) { pv[ply][i + 1] = pv[ply + 1][i]; }
+            pv_length[ply] = pv_length[ply + 1] + 1;
+        }
+
+        // Searches captures and promotions only, until the position is quiet
+        int quiescence(int alpha, int beta, int ply) {
+            pv_length[ply] = 0;
+            if (should_stop()) { return 0; }
+            int stand_pat = evaluate(position);
+            if (ply >= MAX_PLY) { return stand_pat; }
+            if (stand_pat >= beta) { return stand_pat; }
+            alpha = max(alpha, stand_pat);
+
+            MovePicker picker(position, NULL_MOVE, NULL, false);
+            int best = stand_pat;
+            for (PackedMove move = picker.next(); move != NULL_MOVE; move = picker.next()) {
+                Undo undo;
+                if (!make_legal_move(move, undo)) { continue; }
+                int score = -quiescence(-beta, -alpha, ply + 1);
+                position.undo_move(move, undo);
+                if (aborted) { return 0; }
+                if (score > best) {
+                    best = score;
+                    if (score > alpha) {
+                        alpha = score;
+                        update_pv(ply, move);
+                        if (score >= beta) { break; }
+                    }
+                }
+            }
+            return best;
+        }
+
+        int negamax(int alpha, int beta, int depth, int ply) {
+            pv_length[ply] = 0;
+            if (should_stop()) { return 0; }
+            if (position.halfmove_clock >= 100 || position.repetitions() >= 1) { return 0; }
+            bool check = position.in_check();
+            if (check) { depth++; }
+            if (depth <= 0 || ply >= MAX_PLY) { return quiescence(alpha, beta, ply); }
+
+            TTEntry entry;
+            PackedMove hash_move = NULL_MOVE;
+            bool pv_node = beta - alpha > 1;
+            if (tt.probe(position.key, entry)) {
+                hash_move = entry.move;
+                int score = score_from_tt(entry.score, ply);
+                if (!pv_node && entry.depth >= depth && (entry.bound == BOUND_EXACT ||
+                    (entry.bound == BOUND_LOWER && score >= beta) || (entry.bound == BOUND_UPPER && score <= alpha))) {
+                    return score;
+                }
+            }
+
+            // Endings of up to four pieces are decided by the bitbases. Only probed right after a capture or pawn
+            // move, the bitbases don't know the 50 move rule, and the search sees which side makes progress.
+            if (ply > 0 && position.halfmove_clock == 0) {
+                WDL result = bitbases().probe(position);
+                if (result == WDL_WIN || result == WDL_LOSS || result == WDL_DRAW) {
+                    count_metric(METRIC_BITBASE_HITS);
+                    return result == WDL_WIN ? BITBASE_WIN_SCORE - ply : result == WDL_LOSS ? -BITBASE_WIN_SCORE + ply : 0;
+                }
+            }
+
+            MovePicker picker(position, hash_move, killers[ply]);
+            int best = -INFINITE_SCORE;
+            PackedMove best_move = NULL_MOVE;
+            int original_alpha = alpha;
+            int legal = 0;
+            for (PackedMove move = picker.next(); move != NULL_MOVE; move = picker.next()) {
+                Undo undo;
+                if (!make_legal_move(move, undo)) { continue; }
+                legal++;
+                int score;
+                if (legal == 1) { score = -negamax(-beta, -alpha, depth - 1, ply + 1); }
+                else { // Principal variation search, later moves only have to prove they are worse
+                    score = -negamax(-alpha - 1, -alpha, depth - 1, ply + 1);
+                    if (score > alpha && score < beta) { score = -negamax(-beta, -alpha, depth - 1, ply + 1); }
+                }
+                position.undo_move(move, undo);
+                if (aborted) { return 0; }
+                if (score > best) {
+                    best = score;
+                    best_move = move;
+                    if (score > alpha) {
+                        alpha = score;
+                        update_pv(ply, move);
+                        if (score >= beta) {
+                            update_killers(ply, move);
+                            break;
+                        }
+                    }
+                }
+            }
+            if (legal == 0) { return check ? -MATE_SCORE + ply : 0; }
+
+            Bound bound = best >= beta ? BOUND_LOWER : best > original_alpha ? BOUND_EXACT : BOUND_UPPER;
+            tt.store(position.key, best_move, score_to_tt(best, ply), depth, bound);
+            return best;
+        }
+
+        // Searches the root moves from the given index on, and moves the best one to that index.
+        // The moves before it are the earlier principal variations of this depth, which are excluded.
+        bool search_root(int depth, int first, SearchLine& line) {
+            int alpha = -INFINITE_SCORE, beta = INFINITE_SCORE;
+            int best = first;
+            line.pv.clear();
+            for (int i = first; i < (int)root_moves.size(); i++) {
+                Undo undo;
+                position.do_move(root_moves[i], undo);
+                int score;
+                if (i == first) { score = -negamax(-beta, -alpha, depth - 1, 1); }
+                else {
+                    score = -negamax(-alpha - 1, -alpha, depth - 1, 1);
+                    if (score > alpha && !aborted) { score = -negamax(-beta, -alpha, depth - 1, 1); }
+                }
+                position.undo_move(root_moves[i], undo);
+                if (aborted) { return false; }
+                if (score > alpha) {
+                    alpha = score;
+                    best = i;
+                    update_pv(0, root_moves[i]);
+                    line.pv.assign(pv[0], pv[0] + pv_length[0]);
+                }
+            }
+            rotate(root_moves.begin() + first, root_moves.begin() + best, root_moves.begin() + best + 1);
+            line.depth = depth;
+            line.score = alpha;
+            return true;
+        }
+
+    public:
+        atomic<bool> stop; // Set by another thread to end the search, reset by the owner before the next one
+
+        Search(TranspositionTable& tt) : tt(tt) {
+            stop = false;
+            deadline_us = 0;
+        }
+
+        uint64_t getNodes() { return nodes; }
+
+        // Sets the time the running search stops at, may be called from another thread. A ponder search
+        // gets its time limit this way once the opponent played the expected move.
+        void set_deadline(int64_t time_us) { deadline_us = time_us; }
+
+        // Searches the position with iterative deepening. After every completed principal variation the
+        // lines found so far are passed to the report function, the last completed lines are returned.
+        vector<SearchLine> run(const Position& root, SearchLimits limits,
+            function<void(const vector<SearchLine>&)> report = nullptr) {
+            position = root;
+            this->limits = limits;
+            start = chrono::steady_clock::now();
+            if (!limits.ponder) { deadline_us = limits.time_ms ? clock_now_us() + limits.time_ms * 1000LL : 0; }
+            nodes = 0;
+            counted_nodes = 0;
+            aborted = stop;
+            completed_depth = 0;
+            memset(killers, 0, sizeof(killers));
+            tt.new_search();
+
+            PackedMove list[MAX_MOVES];
+            int count = position.generate_moves(list);
+            root_moves.assign(list, list + count);
+            if (root_moves.empty()) { return {}; }
+            TTEntry entry;
+            if (tt.probe(position.key, entry)) { // Start with the best move of an earlier search
+                auto it = find(root_moves.begin(), root_moves.end(), entry.move);
+                if (it != root_moves.end()) { rotate(root_moves.begin(), it, it + 1); }
+            }
+            int multipv = min(max(limits.multipv, 1), (int)root_moves.size());
+            int max_depth = limits.depth > 0 ? min(limits.depth, MAX_PLY - 1) : MAX_PLY - 1;
+
+            vector<SearchLine> completed, lines;
+            for (int depth = 1; depth <= max_depth && !aborted; depth++) {
+                lines = completed;
+                lines.resize(multipv);
+                for (int i = 0; i < multipv; i++) {
+                    SearchLine line;
+                    if (!search_root(depth, i, line)) { break; }
+                    line.nodes = nodes;
+                    line.time_ms = elapsed_ms();
+                    lines[i] = line;
+                    if (i == 0) { tt.store(position.key, line.pv[0], score_to_tt(line.score, 0), depth, BOUND_EXACT); }
+                    if (report) { report(lines); }
+                }
+                if (aborted) { break; }
+                completed = lines;
+                completed_depth = depth;
+                if (abs(completed[0].score) >= MATE_BOUND && depth > MATE_SCORE - abs(completed[0].score)) { break; }
+            }
+            count_nodes();
+            return completed.empty() ? lines : completed;
+        }
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <SDL2/SDL.h>
+
+#include <clock.cpp>
+
+using namespace std;
+
+// Recorded input sessions. The recorder writes every input event the game handles with its time, and the replay
+// feeds them back at the same times of a virtual clock, one frame time per frame and without waiting. The game
+// then sees the same events at the same frames in every replay, and the replay measures what each frame and
+// each event costs in real time, so a recorded session becomes a repeatable benchmark.
+//
+// Sessions are text files, one event per line after the header, times in microseconds since the recording began:
+//   chess-session VERSION FPS
+//   TIME key SYM MOD
+//   TIME button X Y BUTTON CLICKS
+//   TIME wheel Y MOUSE_X MOUSE_Y
+//   TIME quit
+//
+// Searches started in a replay stop by the virtual clock too, but how far they get depends on the machine.
+
+#define SESSION_VERSION 1
+#define SESSION_DRAIN_FRAMES FPS // Frames replayed after the last event, so the work it started is measured
+#define SESSION_SLOWEST_FRAMES 5 // Frames listed in the report
+
+typedef struct {
+    int64_t time_us;
+    SDL_Event event;
+} SessionEvent;
+
+// Name of the kind of an event, for the report
+inline string session_event_name(const SDL_Event& event) {
+    switch (event.type) {
+        case SDL_KEYDOWN: return (string)"key " + SDL_GetKeyName(event.key.keysym.sym);
+        case SDL_MOUSEBUTTONDOWN: return "click";
+        case SDL_MOUSEWHEEL: return "wheel";
+        case SDL_QUIT: return "quit";
+        default: return "other";
+    }
+}
+
+// Writes the input events of a session
+class InputRecorder {
+    private:
+        ofstream out;
+        int64_t start_us = 0;
+
+    public:
+        bool open(string path) {
+            out.open(path, ios::trunc);
+            if (!out) {
+                cout << "Cannot write: " << path << endl;
+                return false;
+            }
+            out << "chess-session " << SESSION_VERSION << " " << FPS << "\n";
+            start_us = clock_now_us();
+            return true;
+        }
+
+        bool is_open() { return out.is_open(); }
+
+        // Records an event the game handles, at the time of the clock it happened, others are left out
+        void record(const SDL_Event& event, int64_t time_us) {
+            if (!out.is_open()) { return; }
+            int64_t time = max<int64_t>(0, time_us - start_us);
+            switch (event.type) {
+                case SDL_KEYDOWN:
+                    out << time << " key " << event.key.keysym.sym << " " << event.key.keysym.mod << "\n";
+                    break;
+                case SDL_MOUSEBUTTONDOWN:
+                    out << time << " button " << event.button.x << " " << event.button.y << " " << (int)event.button.button
+                        << " " << (int)event.button.clicks << "\n";
+                    break;
+                case SDL_MOUSEWHEEL:
+                    out << time << " wheel " << event.wheel.y << " " << event.wheel.mouseX << " " << event.wheel.mouseY << "\n";
+                    break;
+                case SDL_QUIT:
+                    out << time << " quit\n";
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        void close() {
+            if (out.is_open()) { out.close(); }
+        }
+};
+
+// Feeds a recorded session back to the game and measures it
+class SessionReplay {
+    private:
+        typedef chrono::steady_clock::time_point TimePoint;
+
+        vector<SessionEvent> events;
+        size_t next = 0;
+        int frame = 0;
+        int drain = 0; // Frames replayed since the last event
+        int recorded_fps = FPS;
+        bool opened = false;
+        TimePoint frame_start;
+        TimePoint replay_start;
+        vector<double> frame_costs; // Milliseconds of every frame
+        vector<size_t> frame_events; // Events delivered in every frame
+        vector<size_t> frame_first; // Number of the first event delivered in every frame
+        vector<double> latencies; // Milliseconds from delivering each event to presenting its frame
+        ofstream csv;
+
+        static double ms_between(TimePoint start, TimePoint end) {
+            return chrono::duration<double, milli>(end - start).count();
+        }
+
+        static double percentile(vector<double> values, double p) {
+            if (values.empty()) { return 0.0; }
+            int n = (values.size() - 1) * p / 100.0;
+            nth_element(values.begin(), values.begin() + n, values.end());
+            return values[n];
+        }
+
+        static bool parse(string line, SessionEvent& recorded) {
+            istringstream in(line);
+            string kind;
+            SDL_Event& event = recorded.event;
+            memset(&event, 0, sizeof(event));
+            if (!(in >> recorded.time_us >> kind)) { return false; }
+            if (kind == "key") {
+                event.type = SDL_KEYDOWN;
+                event.key.state = SDL_PRESSED;
+                return (bool)(in >> event.key.keysym.sym >> event.key.keysym.mod);
+            }
+            if (kind == "button") {
+                int button, clicks;
+                event.type = SDL_MOUSEBUTTONDOWN;
+                event.button.state = SDL_PRESSED;
+                if (!(in >> event.button.x >> event.button.y >> button >> clicks)) { return false; }
+                event.button.button = button;
+                event.button.clicks = clicks;
+                return true;
+            }
+            if (kind == "wheel") {
+                event.type = SDL_MOUSEWHEEL;
+                return (bool)(in >> event.wheel.y >> event.wheel.mouseX >> event.wheel.mouseY);
+            }
+            if (kind == "quit") {
+                event.type = SDL_QUIT;
+                return true;
+            }
+            return false;
+        }
+
+    public:
+        // Reads a session, csv_path optionally names a file for the cost of every frame
+        bool open(string path, string csv_path = "") {
+            ifstream in(path);
+            string line, magic;
+            int version = 0;
+            if (!in || !getline(in, line) || !(istringstream(line) >> magic >> version >> recorded_fps) ||
+                magic != "chess-session" || version > SESSION_VERSION) {
+                cout << "Not a recorded session: " << path << endl;
+                return false;
+            }
+            events.clear();
+            for (int number = 2; getline(in, line); number++) {
+                SessionEvent event;
+                if (line.empty()) { continue; }
+                if (!parse(line, event)) {
+                    cout << "Invalid event in line " << number << " of " << path << endl;
+                    return false;
+                }
+                events.push_back(event);
+            }
+            stable_sort(events.begin(), events.end(), [](const SessionEvent& a, const SessionEvent& b) {
+                return a.time_us < b.time_us;
+            });
+            if (!csv_path.empty()) {
+                csv.open(csv_path, ios::trunc);
+                csv << "frame,time_us,cost_us,events\n";
+            }
+            next = 0;
+            frame = 0;
+            drain = 0;
+            clock_virtual_us() = 0;
+            opened = true;
+            return true;
+        }
+
+        bool is_open() { return opened; }
+        bool finished() { return next >= events.size() && drain >= SESSION_DRAIN_FRAMES; }
+
+        // Called first in every frame: moves the virtual clock to the frame, and queues the events that are due
+        void begin_frame() {
+            int64_t now = (int64_t)frame * 1000000 / FPS;
+            clock_virtual_us() = now;
+            frame_start = chrono::steady_clock::now();
+            if (frame == 0) { replay_start = frame_start; }
+            size_t delivered = 0;
+            for (; next < events.size() && events[next].time_us <= now; next++) {
+                SDL_Event event = events[next].event;
+                SDL_PushEvent(&event);
+                delivered++;
+            }
+            frame_first.push_back(next - delivered);
+            frame_events.push_back(delivered);
+            drain = delivered ? 0 : drain + 1;
+        }
+
+        // Called after the frame is presented
+        void end_frame() {
+            double cost = ms_between(frame_start, chrono::steady_clock::now());
+            frame_costs.push_back(cost);
+            for (size_t i = 0; i < frame_events.back(); i++) { latencies.push_back(cost); }
+            if (csv.is_open()) {
+                csv << frame << "," << clock_virtual_us().load() << "," << (int64_t)(cost * 1000) << "," << frame_events.back() << "\n";
+            }
+            frame++;
+        }
+
+        // Writes the frame costs, the slowest frames with the events they handled, and the latency of every kind
+        // of event
+        void report(ostream& out) {
+            if (frame_costs.empty()) { return; }
+            char line[160];
+            double session_s = (double)frame / FPS;
+            out << "Replayed " << next << " events in " << frame << " frames, " << session_s << "s of session time in "
+                << ms_between(replay_start, chrono::steady_clock::now()) / 1000 << "s\n";
+            if (recorded_fps != FPS) { out << "The session was recorded at " << recorded_fps << " FPS, replayed at " << FPS << "\n"; }
+            snprintf(line, sizeof(line), "frame cost ms   p50 %7.2f   p90 %7.2f   p99 %7.2f   max %7.2f\n",
+                percentile(frame_costs, 50), percentile(frame_costs, 90), percentile(frame_costs, 99), percentile(frame_costs, 100));
+            out << line;
+
+            vector<int> slowest(frame_costs.size());
+            for (size_t i = 0; i < slowest.size(); i++) { slowest[i] = i; }
+            int shown = min((int)slowest.size(), SESSION_SLOWEST_FRAMES);
+            partial_sort(slowest.begin(), slowest.begin() + shown, slowest.end(), [&](int a, int b) {
+                return frame_costs[a] > frame_costs[b];
+            });
+            out << "slowest frames\n";
+            for (int i = 0; i < shown; i++) {
+                int f = slowest[i];
+                snprintf(line, sizeof(line), "  frame %6d  at %8.3fs  %7.2f ms  %zu events", f, (double)f / FPS,
+                    frame_costs[f], frame_events[f]);
+                out << line;
+                for (size_t e = 0; e < frame_events[f]; e++) {
+                    out << (e == 0 ? ": " : ", ") << session_event_name(events[frame_first[f] + e].event);
+                }
+                out << "\n";
+            }
+
+            map<string, vector<double>> kinds;
+            for (size_t i = 0; i < latencies.size(); i++) { kinds[session_event_name(events[i].event)].push_back(latencies[i]); }
+            snprintf(line, sizeof(line), "%-16s %7s %9s %9s %9s\n", "event", "count", "p50 ms", "p90 ms", "max ms");
+            out << line;
+            for (auto& kind : kinds) {
+                snprintf(line, sizeof(line), "%-16s %7zu %9.2f %9.2f %9.2f\n", kind.first.c_str(), kind.second.size(),
+                    percentile(kind.second, 50), percentile(kind.second, 90), percentile(kind.second, 100));
+                out << line;
+            }
+        }
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <SDL2/SDL.h>
+
+#include <assets.cpp>
+#include <archive.cpp>
+#include <position.cpp>
+#include <constants.h>
+
+using namespace std;
+
+// Many independent games at once, for simul and broadcast screens. Unlike the main board, the boards here aren't
+// made of entities with a texture each: the board, the pieces and the last move marks of every board are quads of
+// one texture atlas, and all of them are drawn by a single SDL_RenderGeometry call per frame. The number of boards
+// then only changes how many vertices are sent, not how many draw calls are made.
+//
+// The boards replay games of an archive, each a move every SIMUL_MOVE_MS and started at a different time, so
+// moves happen all over the screen. A feed of live games sets the positions with set_board instead.
+
+#define SIMUL_MAX_BOARDS 64
+#define SIMUL_MOVE_MS 1500 // Time between the moves of a replayed game
+#define SIMUL_END_MS 4000 // Time the final position is shown before the game starts again
+#define SIMUL_MARGIN 8 // Pixels between the boards
+#define SIMUL_ATLAS_SIZE 512
+#define SIMUL_BOARD_IMAGE 400 // Size of the board image in the atlas, the pieces are in cells below it
+#define SIMUL_CELL 52 // A 50 pixel image with a pixel of space around it, so the filtering doesn't blend neighbours
+
+// Cells of the atlas after the board image, the pieces are at make_piece(type, color)
+#define SIMUL_CELL_MARK 0 // Last move mark, the square 0 is never a piece
+#define SIMUL_CELL_COUNT 16
+
+class SimulView {
+    private:
+        struct SimulBoard {
+            ArchiveGame game;
+            Position position;
+            size_t ply = 0;
+            int last_from = NO_SQUARE, last_to = NO_SQUARE;
+            Uint32 next_ms = 0; // Time of the next move of the replay
+        };
+
+        vector<SimulBoard> boards;
+        SDL_Texture* atlas = NULL;
+        SDL_FRect cells[SIMUL_CELL_COUNT]; // Texture coordinates of the cells, from 0 to 1
+        SDL_FRect board_cell;
+        vector<SDL_Vertex> vertices;
+        vector<int> indices;
+        bool dirty = true;
+        int layout_w = 0, layout_h = 0;
+
+        // Texture coordinates of an area of the atlas, half a texel inside so the filtering stays within it
+        static SDL_FRect atlas_rect(int x, int y, int w, int h) {
+            float texel = 1.0f / SIMUL_ATLAS_SIZE;
+            return { (x + 0.5f) * texel, (y + 0.5f) * texel, (w - 1.0f) * texel, (h - 1.0f) * texel };
+        }
+
+        // Copies an image into the atlas, returns false if it can't be loaded
+        bool add_image(SDL_Surface* target, string name, int x, int y, int size) {
+            SDL_Surface* image = assets().load_image((string)SRC_PATH + "assets/textures/" + name);
+            if (image == NULL) {
+                cout << "Cannot find: " << name << endl;
+                return false;
+            }
+            SDL_Surface* converted = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA32, 0);
+            SDL_FreeSurface(image);
+            if (converted == NULL) { return false; }
+            SDL_SetSurfaceBlendMode(converted, SDL_BLENDMODE_NONE); // Copies the alpha instead of blending with it
+            SDL_Rect rect = { x, y, size, size };
+            SDL_BlitScaled(converted, NULL, target, &rect);
+            SDL_FreeSurface(converted);
+            return true;
+        }
+
+        // Builds the atlas of the board image, the pieces and the last move mark
+        bool create_atlas(SDL_Renderer* renderer) {
+            SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, SIMUL_ATLAS_SIZE, SIMUL_ATLAS_SIZE, 32, SDL_PIXELFORMAT_RGBA32);
+            if (surface == NULL) { return false; }
+            bool ok = add_image(surface, "chess_board.png", 0, 0, SIMUL_BOARD_IMAGE);
+            board_cell = atlas_rect(0, 0, SIMUL_BOARD_IMAGE, SIMUL_BOARD_IMAGE);
+            const char* names[] = { "", "pawn", "knight", "bishop", "rook", "queen", "king" };
+            int per_row = SIMUL_ATLAS_SIZE / SIMUL_CELL;
+            for (int cell = 0; cell < SIMUL_CELL_COUNT && ok; cell++) {
+                int x = cell % per_row * SIMUL_CELL, y = SIMUL_BOARD_IMAGE + cell / per_row * SIMUL_CELL;
+                cells[cell] = atlas_rect(x + 1, y + 1, SIMUL_CELL - 2, SIMUL_CELL - 2);
+                PieceType type = piece_type(cell);
+                if (cell == SIMUL_CELL_MARK) { ok = add_image(surface, "previous_field.png", x + 1, y + 1, SIMUL_CELL - 2); }
+                else if (type != NO_PIECE_TYPE && type <= KING) {
+                    string color = piece_color(cell) == WHITE ? "white_" : "black_";
+                    ok = add_image(surface, color + names[type] + ".png", x + 1, y + 1, SIMUL_CELL - 2);
+                }
+            }
+            if (ok) { atlas = SDL_CreateTextureFromSurface(renderer, surface); }
+            SDL_FreeSurface(surface);
+            if (atlas == NULL) { return false; }
+            SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+            SDL_SetTextureScaleMode(atlas, SDL_ScaleModeLinear); // The boards are drawn smaller than the images
+            return true;
+        }
+
+        // Appends a quad of an atlas area, two triangles
+        void add_quad(float x, float y, float size, const SDL_FRect& uv) {
+            int first = vertices.size();
+            SDL_Color color = { 255, 255, 255, 255 };
+            vertices.push_back({ { x, y }, color, { uv.x, uv.y } });
+            vertices.push_back({ { x + size, y }, color, { uv.x + uv.w, uv.y } });
+            vertices.push_back({ { x + size, y + size }, color, { uv.x + uv.w, uv.y + uv.h } });
+            vertices.push_back({ { x, y + size }, color, { uv.x, uv.y + uv.h } });
+            for (int i : { 0, 1, 2, 0, 2, 3 }) { indices.push_back(first + i); }
+        }
+
+        // Rebuilds the quads of every board, boards are laid out in a grid that fills the view
+        void build(int w, int h) {
+            vertices.clear();
+            indices.clear();
+            int n = boards.size();
+            int columns = 1;
+            float size = 0;
+            for (int c = 1; c <= n; c++) { // The column count that gives the largest boards
+                int rows = (n + c - 1) / c;
+                float fit = min((float)w / c, (float)h / rows) - SIMUL_MARGIN;
+                if (fit > size) {
+                    size = fit;
+                    columns = c;
+                }
+            }
+            int rows = (n + columns - 1) / columns;
+            float left = (w - columns * (size + SIMUL_MARGIN) + SIMUL_MARGIN) / 2;
+            float top = (h - rows * (size + SIMUL_MARGIN) + SIMUL_MARGIN) / 2;
+            float square = size / 8;
+            for (int i = 0; i < n; i++) {
+                const SimulBoard& board = boards[i];
+                float x = left + i % columns * (size + SIMUL_MARGIN), y = top + i / columns * (size + SIMUL_MARGIN);
+                add_quad(x, y, size, board_cell);
+                for (int s : { board.last_from, board.last_to }) {
+                    if (s != NO_SQUARE) { add_quad(x + square_file(s) * square, y + (7 - square_rank(s)) * square, square, cells[SIMUL_CELL_MARK]); }
+                }
+                for (int s = 0; s < 64; s++) {
+                    uint8_t piece = board.position.squares[s];
+                    if (piece != 0) { add_quad(x + square_file(s) * square, y + (7 - square_rank(s)) * square, square, cells[piece]); }
+                }
+            }
+            layout_w = w;
+            layout_h = h;
+            dirty = false;
+        }
+
+        // Starts the game of a board from its first position
+        void restart(SimulBoard& board, Uint32 now) {
+            board.position = Position();
+            if (!board.game.fen.empty()) { board.position.load_fen(board.game.fen); }
+            board.ply = 0;
+            board.last_from = board.last_to = NO_SQUARE;
+            board.next_ms = now + SIMUL_MOVE_MS;
+            dirty = true;
+        }
+
+    public:
+        SimulView() {}
+        SimulView(const SimulView&) = delete;
+
+        // Replays the first games of an archive, at most SIMUL_MAX_BOARDS
+        bool open(string archive, int count, Uint32 now) {
+            ArchiveReader reader;
+            if (!reader.open(archive)) {
+                cout << "Cannot read the games of the simul from " << archive << endl;
+                return false;
+            }
+            count = min(count, SIMUL_MAX_BOARDS);
+            boards.clear();
+            SimulBoard board;
+            while ((int)boards.size() < count && reader.next(board.game)) {
+                Position start;
+                if (!board.game.fen.empty() && !start.load_fen(board.game.fen)) { continue; }
+                boards.push_back(board);
+            }
+            for (size_t i = 0; i < boards.size(); i++) {
+                restart(boards[i], now);
+                boards[i].next_ms = now + SIMUL_MOVE_MS * i / boards.size(); // Spreads the moves over the interval
+            }
+            vertices.reserve(boards.size() * 36 * 4);
+            indices.reserve(boards.size() * 36 * 6);
+            return !boards.empty();
+        }
+
+        bool is_open() { return !boards.empty(); }
+        int getCount() { return boards.size(); }
+
+        // Shows a position on a board, e.g. from a live game. move is the last move, or NULL_MOVE.
+        void set_board(int index, const Position& position, PackedMove move) {
+            if (index < 0 || index >= (int)boards.size()) { return; }
+            SimulBoard& board = boards[index];
+            board.position = position;
+            board.game.moves.clear(); // No longer replayed
+            board.last_from = move != NULL_MOVE ? move_from(move) : NO_SQUARE;
+            board.last_to = move != NULL_MOVE ? move_to(move) : NO_SQUARE;
+            dirty = true;
+        }
+
+        // Plays the moves of the replayed games that are due
+        void update(Uint32 now) {
+            for (auto& board : boards) {
+                if (board.game.moves.empty() || (int32_t)(now - board.next_ms) < 0) { continue; }
+                if (board.ply == board.game.moves.size()) {
+                    restart(board, now);
+                    continue;
+                }
+                PackedMove move = board.game.moves[board.ply++];
+                Undo undo;
+                board.position.do_move(move, undo);
+                board.position.history.clear(); // Only the pieces are shown, the keys would only pile up
+                board.last_from = move_from(move);
+                board.last_to = move_to(move);
+                board.next_ms = now + (board.ply == board.game.moves.size() ? SIMUL_END_MS : SIMUL_MOVE_MS);
+                dirty = true;
+            }
+        }
+
+        // Draws every board into a view of the given size with a single draw call
+        void render(SDL_Renderer* renderer, int w, int h) {
+            if (boards.empty()) { return; }
+            if (atlas == NULL && !create_atlas(renderer)) {
+                cout << "Cannot create the simul atlas: " << SDL_GetError() << endl;
+                boards.clear();
+                return;
+            }
+            if (dirty || w != layout_w || h != layout_h) { build(w, h); }
+            SDL_RenderGeometry(renderer, atlas, vertices.data(), vertices.size(), indices.data(), indices.size());
+        }
+
+        // Destroys the atlas, called before the renderer is destroyed
+        void release() {
+            if (atlas != NULL) { SDL_DestroyTexture(atlas); }
+            atlas = NULL;
+        }
+};
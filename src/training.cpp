@@ -0,0 +1,198 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstring>
+
+#ifdef CHESS_ZLIB
+#include <zlib.h>
+#endif
+
+#include <position.cpp>
+#include <archive.cpp>
+
+using namespace std;
+
+// Training data for tuning the evaluation: positions packed into fixed size records, written in chunks.
+//
+// File layout, all numbers little endian:
+//   header   "CHSP", version (u16), record size (u16)
+//   chunks   records (u32), stored bytes (u32), compressed (u8), then the records, deflated if compressed
+// Records are stored as they are in memory, which is little endian on every supported platform.
+
+#define TRAINING_VERSION 1
+#define TRAINING_CHUNK_RECORDS 65536 // 2MB of records per chunk
+
+// A position in 32 bytes. The pieces are stored as 4 bit codes (the same as Position::squares) in the
+// order of the occupied squares, so 16 bytes hold the 32 pieces a position can have at most.
+typedef struct {
+    uint64_t occupancy;
+    uint8_t pieces[16];
+    uint8_t turn_castling; // Castling rights in bits 0-3, side to move in bit 4
+    int8_t en_passant;
+    uint8_t halfmove_clock;
+    uint8_t result; // GameResult of the game the position is from
+    int16_t score; // Search score in centipawns from white's view
+    uint16_t fullmove;
+} PackedPosition;
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition has to stay 32 bytes");
+
+// Packs a position, returns false if it has more than 32 pieces, which only a hand made position can have
+inline bool pack_position(const Position& position, GameResult result, int score, PackedPosition& packed) {
+    memset(&packed, 0, sizeof(packed));
+    int count = 0;
+    for (int s = 0; s < 64; s++) {
+        if (position.squares[s] == 0) { continue; }
+        if (count == 2 * sizeof(packed.pieces)) { return false; }
+        packed.occupancy |= 1ULL << s;
+        packed.pieces[count / 2] |= position.squares[s] << (4 * (count & 1));
+        count++;
+    }
+    packed.turn_castling = position.castling | (position.turn << 4);
+    packed.en_passant = position.en_passant;
+    packed.halfmove_clock = min((int)position.halfmove_clock, 255);
+    packed.result = result;
+    packed.score = score;
+    packed.fullmove = position.fullmove;
+    return true;
+}
+
+inline void unpack_position(const PackedPosition& packed, Position& position) {
+    memset(position.squares, 0, sizeof(position.squares));
+    int count = 0;
+    for (uint64_t occupied = packed.occupancy; occupied != 0; occupied &= occupied - 1) {
+        int s = __builtin_ctzll(occupied);
+        uint8_t piece = (packed.pieces[count / 2] >> (4 * (count & 1))) & 15;
+        position.squares[s] = piece;
+        if (piece_type(piece) == KING) { position.king_square[piece_color(piece)] = s; }
+        count++;
+    }
+    position.turn = (Color)((packed.turn_castling >> 4) & 1);
+    position.castling = packed.turn_castling & ALL_CASTLING;
+    position.en_passant = packed.en_passant;
+    position.halfmove_clock = packed.halfmove_clock;
+    position.fullmove = packed.fullmove;
+    position.history.clear();
+    position.key = position.compute_key();
+}
+
+// Appends chunks of records to a training file. Chunks are compressed by the calling thread,
+// and only the write itself is locked, so many threads can share one writer.
+class TrainingWriter {
+    private:
+        ofstream file;
+        mutex lock;
+        bool compress;
+        uint64_t records = 0;
+        uint64_t bytes = 0;
+
+    public:
+        // Opens the file for appending, compression is only available when built with zlib
+        bool open(string path, bool compress) {
+#ifndef CHESS_ZLIB
+            if (compress) {
+                cout << "Compression is not available, this build has no zlib\n";
+                compress = false;
+            }
+#endif
+            this->compress = compress;
+            bool exists = filesystem::exists(path) && filesystem::file_size(path) > 0;
+            file.open(path, ios::binary | ios::app);
+            if (!file) {
+                cout << "Cannot write: " << path << endl;
+                return false;
+            }
+            if (!exists) {
+                string header = "CHSP";
+                header += char(TRAINING_VERSION & 255);
+                header += char(TRAINING_VERSION >> 8);
+                header += char(sizeof(PackedPosition) & 255);
+                header += char(sizeof(PackedPosition) >> 8);
+                file.write(header.data(), header.size());
+                bytes += header.size();
+            }
+            return true;
+        }
+
+        void write(const PackedPosition* data, uint32_t count) {
+            if (count == 0) { return; }
+            const char* stored = (const char*)data;
+            uint32_t stored_bytes = count * sizeof(PackedPosition);
+            bool compressed = false;
+#ifdef CHESS_ZLIB
+            vector<Bytef> buffer;
+            if (compress) {
+                uLongf length = compressBound(stored_bytes);
+                buffer.resize(length);
+                if (compress2(buffer.data(), &length, (const Bytef*)data, stored_bytes, Z_BEST_SPEED) == Z_OK &&
+                    length < stored_bytes) {
+                    stored = (const char*)buffer.data();
+                    stored_bytes = length;
+                    compressed = true;
+                }
+            }
+#endif
+            string header;
+            put_u32(header, count);
+            put_u32(header, stored_bytes);
+            header += char(compressed);
+
+            lock_guard<mutex> guard(lock);
+            file.write(header.data(), header.size());
+            file.write(stored, stored_bytes);
+            records += count;
+            bytes += header.size() + stored_bytes;
+        }
+
+        uint64_t getRecords() { return records; }
+        uint64_t getBytes() { return bytes; }
+
+        void close() { file.close(); }
+};
+
+// Reads a training file one chunk at a time
+class TrainingReader {
+    private:
+        ifstream file;
+        vector<char> buffer;
+
+    public:
+        bool open(string path) {
+            file.open(path, ios::binary);
+            char header[8];
+            file.read(header, sizeof(header));
+            if (!file || memcmp(header, "CHSP", 4) != 0 || (uint8_t)header[6] != sizeof(PackedPosition)) {
+                cout << "Not a training file: " << path << endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Reads the next chunk into the records, returns false at the end of the file
+        bool next_chunk(vector<PackedPosition>& records) {
+            uint8_t header[9];
+            if (!file.read((char*)header, sizeof(header))) { return false; }
+            uint32_t count = get_u32(header);
+            uint32_t stored_bytes = get_u32(header + 4);
+            bool compressed = header[8] != 0;
+            records.resize(count);
+            if (!compressed) {
+                if (stored_bytes != count * sizeof(PackedPosition)) { return false; }
+                return (bool)file.read((char*)records.data(), stored_bytes);
+            }
+#ifdef CHESS_ZLIB
+            buffer.resize(stored_bytes);
+            if (!file.read(buffer.data(), stored_bytes)) { return false; }
+            uLongf length = count * sizeof(PackedPosition);
+            return uncompress((Bytef*)records.data(), &length, (const Bytef*)buffer.data(), stored_bytes) == Z_OK &&
+                length == count * sizeof(PackedPosition);
+#else
+            cout << "Compressed training data needs a build with zlib\n";
+            return false;
+#endif
+        }
+};
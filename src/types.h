@@ -0,0 +1,22 @@
+#pragma once
+
+// Shared types for the rules, used both by the SDL board and the headless position
+
+enum Color { BLACK, WHITE };
+
+enum PieceType { NO_PIECE_TYPE, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+
+// Castling rights, stored as bits
+enum Castling { WHITE_KING_SIDE = 1, WHITE_QUEEN_SIDE = 2, BLACK_KING_SIDE = 4, BLACK_QUEEN_SIDE = 8, ALL_CASTLING = 15 };
+
+// Enum to represent the current state of the board
+enum State { 
+    NEUTRAL, 
+    WHITE_CHECK, 
+    BLACK_CHECK, 
+    WHITE_CHECKMATE, 
+    BLACK_CHECKMATE, 
+    WHITE_TIMES_UP,
+    BLACK_TIMES_UP,
+    TIE
+};
@@ -0,0 +1,84 @@
+/* Checks that the C interface rejects positions whose moves wouldn't fit into CHESSCORE_MAX_MOVES */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chesscore.h>
+
+#define WHITE_PIECE(type) ((type) + 8)
+#define QUEEN 5
+#define KING 6
+#define PAWN 1
+
+static int failures = 0;
+
+static void expect(int condition, const char* what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/* Feeds a position through every call, it has to be invalid everywhere */
+static void expect_invalid(const chesscore_position* position, const char* what) {
+    uint8_t status = 0;
+    uint16_t moves[CHESSCORE_MAX_MOVES];
+    uint32_t offsets[2];
+    uint16_t move = 0;
+    chesscore_position result;
+    uint64_t nodes = 1;
+    char fen[128];
+    chesscore_status(position, 1, &status);
+    expect(status == CHESSCORE_INVALID, what);
+    expect(chesscore_legal_moves(position, 1, moves, CHESSCORE_MAX_MOVES, offsets) == 0, what);
+    expect(chesscore_play(position, &move, 1, &result) == 0, what);
+    chesscore_perft(position, 1, 1, &nodes);
+    expect(nodes == 0, what);
+    expect(chesscore_to_fen(position, fen, sizeof(fen)) == 0, what);
+}
+
+static void empty_position(chesscore_position* position) {
+    memset(position, 0, sizeof(*position));
+    position->side = CHESSCORE_WHITE;
+    position->en_passant = CHESSCORE_NO_SQUARE;
+    position->fullmove = 1;
+    position->squares[4] = WHITE_PIECE(KING);
+    position->squares[60] = KING;
+}
+
+int main(void) {
+    chesscore_position position;
+    const char* fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "QQQQQQQQ/QQQQQQQQ/QQQQQQQQ/8/8/8/k7/4K3 w - - 0 1",
+        "4k3/8/8/8/8/8/8/P3K3 w - - 0 1",
+    };
+    chesscore_position read[3];
+    uint16_t moves[CHESSCORE_MAX_MOVES];
+    uint32_t offsets[2];
+    int square;
+
+    expect(chesscore_abi_version() == CHESSCORE_ABI_VERSION, "ABI version");
+
+    empty_position(&position);
+    for (square = 8; square < 48; square++) {
+        if (square != 12) { position.squares[square] = WHITE_PIECE(QUEEN); }
+    }
+    expect_invalid(&position, "more than 16 white pieces");
+
+    empty_position(&position);
+    for (square = 16; square < 25; square++) { position.squares[square] = WHITE_PIECE(PAWN); }
+    expect_invalid(&position, "more than 8 white pawns");
+
+    empty_position(&position);
+    position.squares[63] = PAWN;
+    expect_invalid(&position, "pawn on the last rank");
+
+    expect(chesscore_from_fen(fens, 3, read) == 1, "only the start position is read from FEN");
+    expect(chesscore_legal_moves(read, 1, moves, CHESSCORE_MAX_MOVES, offsets) == 20, "moves of the start position");
+    expect_invalid(&read[1], "too many queens from FEN");
+    expect_invalid(&read[2], "pawn on the first rank from FEN");
+
+    if (failures == 0) { printf("All checks passed\n"); }
+    return failures == 0 ? 0 : 1;
+}
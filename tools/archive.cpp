@@ -0,0 +1,111 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+
+#include <archive.cpp>
+
+using namespace std;
+
+// Command line tool for game archives:
+//   chess-archive info FILE             games, blocks and bytes per ply
+//   chess-archive dump FILE GAME        prints one game in coordinate notation
+//   chess-archive replay FILE           replays every game, and reports the speed
+//   chess-archive random FILE GAMES     appends random games, for testing and benchmarks
+
+static double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static const char* result_names[] = { "*", "1-0", "0-1", "1/2-1/2" };
+
+static int info(string path) {
+    ArchiveIndex index;
+    if (!read_archive_index(path, index)) {
+        cout << "Not a game archive: " << path << endl;
+        return 1;
+    }
+    ArchiveReader reader;
+    reader.open(path);
+    string fen;
+    GameResult result;
+    const uint8_t* indices;
+    uint32_t plies;
+    uint64_t total_plies = 0;
+    while (reader.next_raw(fen, result, indices, plies)) { total_plies += plies; }
+    uint64_t size = filesystem::file_size(path);
+    cout << "games " << index.games << ", blocks " << index.blocks.size() << ", plies " << total_plies
+         << ", bytes " << size << ", bytes per ply " << (total_plies ? (double)size / total_plies : 0.0) << endl;
+    return 0;
+}
+
+static int dump(string path, uint32_t number) {
+    ArchiveReader reader;
+    ArchiveGame game;
+    if (!reader.open(path) || !reader.seek(number) || !reader.next(game)) {
+        cout << "Cannot read game " << number << endl;
+        return 1;
+    }
+    if (!game.fen.empty()) { cout << "[FEN \"" << game.fen << "\"]\n"; }
+    for (size_t i = 0; i < game.moves.size(); i++) {
+        if (i % 2 == 0) { cout << i / 2 + 1 << ". "; }
+        cout << move_name(game.moves[i]) << " ";
+    }
+    cout << result_names[game.result] << endl;
+    return 0;
+}
+
+static int replay(string path) {
+    ArchiveReader reader;
+    if (!reader.open(path)) { return 1; }
+    auto start = chrono::steady_clock::now();
+    ArchiveGame game;
+    uint64_t games = 0, plies = 0;
+    while (reader.next(game)) {
+        games++;
+        plies += game.moves.size();
+    }
+    double seconds = seconds_since(start);
+    if (games != reader.game_count()) {
+        cout << "Archive is damaged after game " << games << endl;
+        return 1;
+    }
+    cout << games << " games, " << plies << " plies in " << seconds << "s, "
+         << (uint64_t)(plies / max(seconds, 1e-9)) << " plies/s\n";
+    return 0;
+}
+
+static int random_games(string path, int count) {
+    ArchiveWriter writer;
+    if (!writer.open(path)) { return 1; }
+    mt19937_64 rng(random_device{}());
+    PackedMove list[MAX_MOVES];
+    for (int i = 0; i < count; i++) {
+        Position position;
+        ArchiveGame game = { "", UNKNOWN_RESULT, {} };
+        State state = NEUTRAL;
+        while ((state = position.state()) == NEUTRAL || state == WHITE_CHECK || state == BLACK_CHECK) {
+            if (game.moves.size() >= 400) { break; }
+            int n = position.generate_moves(list);
+            PackedMove move = list[rng() % n];
+            Undo undo;
+            position.do_move(move, undo);
+            game.moves.push_back(move);
+        }
+        game.result = result_from_state(state);
+        writer.write_game(game);
+    }
+    writer.close();
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    string command = argc > 2 ? argv[1] : "";
+    if (command == "info") { return info(argv[2]); }
+    if (command == "dump" && argc > 3) { return dump(argv[2], atoi(argv[3])); }
+    if (command == "replay") { return replay(argv[2]); }
+    if (command == "random" && argc > 3) { return random_games(argv[2], atoi(argv[3])); }
+    cout << "Usage: chess-archive info FILE | dump FILE GAME | replay FILE | random FILE GAMES\n";
+    return 1;
+}
@@ -0,0 +1,140 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+
+#include <bitbase.cpp>
+
+using namespace std;
+
+// Command line tool for the endgame bitbases:
+//   chess-bitbase generate OUTPUT [TABLE...] [--threads N]
+//                                   builds the tables, e.g. KRKP, every table of three or four pieces by default
+//   chess-bitbase probe FILE FEN    result of the position and of each of its moves
+//   chess-bitbase check FILE [TABLE...]
+//                                   compares every position with the results of its moves, every table by default
+
+static int generate(string output, vector<string> tables, int threads) {
+    auto start = chrono::steady_clock::now();
+    if (tables.empty()) { // Every table, the pieces of each side ordered from the strongest
+        const char* pieces[] = { "Q", "R", "B", "N", "P" };
+        for (int a = 0; a < 5; a++) {
+            tables.push_back((string)"K" + pieces[a] + "K");
+            for (int b = a; b < 5; b++) { tables.push_back((string)"K" + pieces[a] + pieces[b] + "K"); }
+            for (int b = a; b < 5; b++) { tables.push_back((string)"K" + pieces[a] + "K" + pieces[b]); }
+        }
+    }
+    BitbaseGenerator generator(threads);
+    for (auto& table : tables) {
+        if (!generator.generate(table)) { return 1; }
+    }
+    if (!generator.write(output)) { return 1; }
+    cout << "Written in " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << "s\n";
+    return 0;
+}
+
+static int probe(string path, string fen) {
+    const char* names[] = { "draw", "win", "loss", "invalid", "unknown" };
+    Bitbases bases;
+    Position position;
+    if (!bases.open(path)) { return 1; }
+    if (!position.load_fen(fen)) {
+        cout << "Invalid position: " << fen << endl;
+        return 1;
+    }
+    cout << "position " << names[bases.probe(position)] << "\n";
+    PackedMove list[MAX_MOVES];
+    int count = position.generate_moves(list);
+    for (int i = 0; i < count; i++) {
+        string san = position.san(list[i]);
+        Undo undo;
+        position.do_move(list[i], undo);
+        WDL result = bases.probe(position);
+        position.undo_move(list[i], undo);
+        result = bitbase_flip(result); // For the mover
+        printf("%-8s %s\n", san.c_str(), names[result]);
+    }
+    return 0;
+}
+
+// Result for the side to move after a move, with the en passant captures the tables leave out
+static WDL child_result(Bitbases& bases, Position& position) {
+    int en_passant = position.en_passant;
+    position.en_passant = NO_SQUARE;
+    WDL best = bases.probe(position);
+    position.en_passant = en_passant;
+    if (en_passant == NO_SQUARE) { return best; }
+    PackedMove list[MAX_MOVES];
+    int count = position.generate_moves(list);
+    for (int i = 0; i < count; i++) {
+        if (!position.is_en_passant(list[i])) { continue; }
+        Undo undo;
+        position.do_move(list[i], undo);
+        best = bitbase_better(best, bitbase_flip(bases.probe(position)));
+        position.undo_move(list[i], undo);
+    }
+    return best;
+}
+
+// Checks that every position of the tables is won if a move leads into a lost position, lost if all lead into won
+// ones, and drawn otherwise. The tables their captures and promotions lead into have to be in the file too.
+static int check(string path, vector<string> tables) {
+    const char* names[] = { "draw", "win", "loss", "invalid", "unknown" };
+    Bitbases bases;
+    if (!bases.open(path)) { return 1; }
+    if (tables.empty()) { tables = bases.getNames(); }
+    uint64_t wrong = 0;
+    for (auto& name : tables) {
+        BitbaseLayout layout;
+        if (!layout.parse(name) || !bases.has(name)) {
+            cout << "No table: " << name << endl;
+            return 1;
+        }
+        uint64_t checked = 0, mismatches = 0;
+        Position position;
+        int squares[4];
+        Color turn;
+        PackedMove list[MAX_MOVES];
+        for (uint64_t number = 0; number < layout.positions; number++) {
+            if (!layout.decode(number, squares, turn) || !layout.setup(squares, turn, position)) { continue; }
+            checked++;
+            int count = position.generate_moves(list);
+            WDL expected = count == 0 ? (position.in_check() ? WDL_LOSS : WDL_DRAW) : WDL_INVALID;
+            for (int i = 0; i < count; i++) {
+                Undo undo;
+                position.do_move(list[i], undo);
+                expected = bitbase_better(expected, bitbase_flip(child_result(bases, position)));
+                position.undo_move(list[i], undo);
+            }
+            WDL stored = bases.probe(position);
+            if (stored == expected) { continue; }
+            if (mismatches++ < 10) { cout << position.fen() << ": " << names[stored] << ", expected " << names[expected] << "\n"; }
+        }
+        cout << name << ": " << checked << " positions, " << mismatches << " mismatches" << endl;
+        wrong += mismatches;
+    }
+    return wrong == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    string command = argc > 2 ? argv[1] : "";
+    if (command == "generate") {
+        vector<string> tables;
+        int threads = max(1, (int)thread::hardware_concurrency());
+        for (int i = 3; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc) { threads = atoi(argv[++i]); }
+            else { tables.push_back(arg); }
+        }
+        return generate(argv[2], tables, threads);
+    }
+    if (command == "probe" && argc > 3) { return probe(argv[2], argv[3]); }
+    if (command == "check") { return check(argv[2], vector<string>(argv + 3, argv + argc)); }
+    cout << "Usage: chess-bitbase generate OUTPUT [TABLE...] [--threads N]\n"
+         << "       chess-bitbase probe FILE FEN\n"
+         << "       chess-bitbase check FILE [TABLE...]\n";
+    return 1;
+}
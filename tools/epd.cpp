@@ -0,0 +1,222 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+#include <search.cpp>
+
+using namespace std;
+
+// Runs tactical test suites in EPD format, one position per thread, to compare how fast builds solve them.
+//
+//   chess-epd FILE... [--threads N] [--time MS] [--nodes N] [--hash MB]
+//
+// Every line is a position (the first four FEN fields) with operations, e.g.
+//   2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - bm Qg6; id "WAC.001";
+// A position is solved if the search ends on one of the "bm" moves, or on none of the "am" moves. The time to
+// solution is when the search settled on a right move and kept it until the end.
+
+#define EPD_HASH_MB 16
+#define EPD_TIME_MS 1000 // Per position, when neither a time nor a node limit is given
+
+typedef struct {
+    string id;
+    string fen;
+    vector<PackedMove> best; // bm
+    vector<PackedMove> avoid; // am
+    string expected; // The operations as written, for the report
+} EpdPosition;
+
+typedef struct {
+    bool solved;
+    int solution_ms; // -1 if not solved
+    uint64_t solution_nodes;
+    uint64_t nodes;
+    int depth;
+    string move;
+} EpdResult;
+
+// Splits the operations after the position, "bm Qg6 Qh5; id "x";" into opcode and operands
+static vector<pair<string, vector<string>>> parse_operations(string text) {
+    vector<pair<string, vector<string>>> operations;
+    size_t i = 0;
+    while (i < text.length()) {
+        while (i < text.length() && isspace((unsigned char)text[i])) { i++; }
+        if (i >= text.length()) { break; }
+        size_t end = i;
+        while (end < text.length() && !isspace((unsigned char)text[end]) && text[end] != ';') { end++; }
+        pair<string, vector<string>> operation(text.substr(i, end - i), {});
+        i = end;
+        while (i < text.length() && text[i] != ';') {
+            if (isspace((unsigned char)text[i])) { i++; }
+            else if (text[i] == '"') {
+                size_t close = text.find('"', i + 1);
+                if (close == string::npos) { close = text.length(); }
+                operation.second.push_back(text.substr(i + 1, close - i - 1));
+                i = close + 1;
+            }
+            else {
+                end = i;
+                while (end < text.length() && !isspace((unsigned char)text[end]) && text[end] != ';') { end++; }
+                operation.second.push_back(text.substr(i, end - i));
+                i = end;
+            }
+        }
+        i++; // The ';'
+        operations.push_back(operation);
+    }
+    return operations;
+}
+
+// Reads the positions of an EPD file, skipping empty lines and printing the lines that can't be used
+static bool load_epd(string path, vector<EpdPosition>& positions) {
+    ifstream in(path);
+    if (!in) {
+        cout << "Cannot read: " << path << endl;
+        return false;
+    }
+    string line;
+    int number = 0;
+    while (getline(in, line)) {
+        number++;
+        istringstream fields(line);
+        string parts[4];
+        if (!(fields >> parts[0] >> parts[1] >> parts[2] >> parts[3])) { continue; }
+        EpdPosition epd;
+        epd.fen = parts[0] + " " + parts[1] + " " + parts[2] + " " + parts[3];
+        epd.id = path + ":" + to_string(number);
+        Position position;
+        if (!position.load_fen(epd.fen)) {
+            cout << epd.id << ": invalid position\n";
+            continue;
+        }
+        string rest;
+        getline(fields, rest);
+        bool valid = true;
+        for (auto& operation : parse_operations(rest)) {
+            if (operation.first == "id" && !operation.second.empty()) { epd.id = operation.second[0]; }
+            if (operation.first != "bm" && operation.first != "am") { continue; }
+            epd.expected += (epd.expected.empty() ? "" : " ") + operation.first;
+            for (auto& san : operation.second) {
+                PackedMove move = position.parse_san(san);
+                if (move == NULL_MOVE) { move = position.parse_move(san); }
+                if (move == NULL_MOVE) {
+                    cout << epd.id << ": unknown move " << san << endl;
+                    valid = false;
+                }
+                (operation.first == "bm" ? epd.best : epd.avoid).push_back(move);
+                epd.expected += " " + san;
+            }
+        }
+        if (!valid) { continue; }
+        if (epd.best.empty() && epd.avoid.empty()) {
+            cout << epd.id << ": no bm or am operation\n";
+            continue;
+        }
+        positions.push_back(epd);
+    }
+    return true;
+}
+
+static bool is_solution(const EpdPosition& epd, PackedMove move) {
+    if (!epd.best.empty()) { return find(epd.best.begin(), epd.best.end(), move) != epd.best.end(); }
+    return find(epd.avoid.begin(), epd.avoid.end(), move) == epd.avoid.end();
+}
+
+static EpdResult solve(const EpdPosition& epd, Search& search, SearchLimits limits) {
+    Position position;
+    position.load_fen(epd.fen);
+    EpdResult result = { false, -1, 0, 0, 0, "" };
+    vector<SearchLine> lines = search.run(position, limits, [&](const vector<SearchLine>& lines) {
+        if (!is_solution(epd, lines[0].pv[0])) { result.solution_ms = -1; }
+        else if (result.solution_ms < 0) {
+            result.solution_ms = lines[0].time_ms;
+            result.solution_nodes = lines[0].nodes;
+        }
+    });
+    result.nodes = search.getNodes();
+    if (lines.empty()) { return result; } // Mate or stalemate, nothing to play
+    result.depth = lines[0].depth;
+    result.move = position.san(lines[0].pv[0]);
+    result.solved = is_solution(epd, lines[0].pv[0]);
+    if (!result.solved) { result.solution_ms = -1; }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> files;
+    int threads = thread::hardware_concurrency();
+    int hash_mb = EPD_HASH_MB;
+    SearchLimits limits = { 0, 1, 0, 0, false };
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) { threads = atoi(argv[++i]); }
+        else if (arg == "--time" && i + 1 < argc) { limits.time_ms = atoi(argv[++i]); }
+        else if (arg == "--nodes" && i + 1 < argc) { limits.nodes = atoll(argv[++i]); }
+        else if (arg == "--hash" && i + 1 < argc) { hash_mb = atoi(argv[++i]); }
+        else if (arg[0] != '-') { files.push_back(arg); }
+        else { files.clear(); break; }
+    }
+    if (files.empty()) {
+        cout << "Usage: chess-epd FILE... [--threads N] [--time MS] [--nodes N] [--hash MB]\n";
+        return 1;
+    }
+    if (limits.time_ms == 0 && limits.nodes == 0) { limits.time_ms = EPD_TIME_MS; }
+    vector<EpdPosition> positions;
+    for (auto& file : files) {
+        if (!load_epd(file, positions)) { return 1; }
+    }
+    threads = max(1, min(threads, (int)positions.size()));
+
+    // Every thread has its own table, so positions don't help each other and results don't depend on the order
+    vector<EpdResult> results(positions.size());
+    atomic<size_t> next(0);
+    atomic<int> done(0), solved(0);
+    mutex print_lock;
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            TranspositionTable tt(hash_mb);
+            Search search(tt);
+            for (size_t i = next++; i < positions.size(); i = next++) {
+                tt.clear();
+                results[i] = solve(positions[i], search, limits);
+                if (results[i].solved) { solved++; }
+                lock_guard<mutex> guard(print_lock);
+                cout << "\r" << ++done << "/" << positions.size() << " positions, " << solved << " solved" << flush;
+            }
+        });
+    }
+    for (auto& w : workers) { w.join(); }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "\r";
+
+    uint64_t total_nodes = 0, solution_nodes = 0;
+    int64_t solution_ms = 0;
+    for (size_t i = 0; i < positions.size(); i++) {
+        EpdResult& r = results[i];
+        cout << left << setw(16) << positions[i].id << (r.solved ? " ok   " : " FAIL ") << setw(8) << r.move
+             << setw(24) << positions[i].expected << right << " depth " << setw(2) << r.depth << ", "
+             << setw(10) << r.nodes << " nodes";
+        if (r.solved) { cout << ", solved after " << r.solution_ms << " ms, " << r.solution_nodes << " nodes"; }
+        cout << endl;
+        total_nodes += r.nodes;
+        if (r.solved) {
+            solution_ms += r.solution_ms;
+            solution_nodes += r.solution_nodes;
+        }
+    }
+    cout << "Solved " << solved << " of " << positions.size() << " ("
+         << fixed << setprecision(1) << 100.0 * solved / max((size_t)1, positions.size()) << "%)";
+    if (solved > 0) { cout << ", on average after " << solution_ms / solved << " ms and " << solution_nodes / solved << " nodes"; }
+    cout << endl << total_nodes << " nodes in " << setprecision(2) << seconds << "s on " << threads << " threads, "
+         << (uint64_t)(total_nodes / max(seconds, 0.001)) << " nodes/s\n";
+    return solved == (int)positions.size() ? 0 : 2;
+}
@@ -0,0 +1,106 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+#include <explorer.cpp>
+
+using namespace std;
+
+// Command line tool for the opening explorer index:
+//   chess-explorer build INDEX ARCHIVE... [--threads N] [--plies N] [--memory MB]
+//                                         replays the archives and writes the index
+//   chess-explorer show INDEX [FEN]       moves played in the position, the start position by default
+//   chess-explorer bench INDEX ARCHIVE    looks up every position of the archive's games, and reports the time
+
+static double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static int build(string index, vector<string> archives, int threads, int plies, int memory_mb) {
+    auto start = chrono::steady_clock::now();
+    ExplorerBuilder builder(index, threads, plies, memory_mb);
+    for (auto& archive : archives) {
+        if (!builder.add_archive(archive)) { return 1; }
+    }
+    if (!builder.finish()) { return 1; }
+    OpeningExplorer explorer;
+    if (!explorer.open(index)) { return 1; }
+    cout << builder.getGames() << " games (" << builder.getSkipped() << " without a result left out), "
+         << explorer.getEntries() << " moves in " << seconds_since(start) << "s\n";
+    return 0;
+}
+
+static int show(string index, string fen) {
+    OpeningExplorer explorer;
+    Position position;
+    if (!explorer.open(index)) { return 1; }
+    if (!fen.empty() && !position.load_fen(fen)) {
+        cout << "Invalid position: " << fen << endl;
+        return 1;
+    }
+    uint32_t count;
+    const ExplorerEntry* found = explorer.find(position.key, count);
+    vector<ExplorerEntry> moves(found, found + count);
+    sort(moves.begin(), moves.end(), [](const ExplorerEntry& a, const ExplorerEntry& b) {
+        return explorer_games(a) > explorer_games(b);
+    });
+    for (auto& entry : moves) {
+        double games = explorer_games(entry);
+        printf("%-8s %8u  %5.1f%% %5.1f%% %5.1f%%\n", position.san(entry.move).c_str(), explorer_games(entry),
+            100 * entry.white_wins / games, 100 * entry.draws / games, 100 * entry.black_wins / games);
+    }
+    if (moves.empty()) { cout << "The position isn't in the index\n"; }
+    return 0;
+}
+
+static int bench(string index, string archive) {
+    OpeningExplorer explorer;
+    ArchiveReader reader;
+    if (!explorer.open(index) || !reader.open(archive)) { return 1; }
+    vector<uint64_t> keys;
+    ArchiveGame game;
+    while (reader.next(game)) {
+        Position position;
+        if (!game.fen.empty() && !position.load_fen(game.fen)) { continue; }
+        for (PackedMove move : game.moves) {
+            keys.push_back(position.key);
+            Undo undo;
+            position.do_move(move, undo);
+        }
+    }
+    auto start = chrono::steady_clock::now();
+    uint64_t found = 0;
+    for (uint64_t key : keys) {
+        uint32_t count;
+        if (explorer.find(key, count) != NULL) { found++; }
+    }
+    double seconds = seconds_since(start);
+    cout << keys.size() << " lookups, " << found << " found, " << seconds * 1e6 / max<size_t>(1, keys.size())
+         << " us per lookup\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    string command = argc > 2 ? argv[1] : "";
+    if (command == "build" && argc > 3) {
+        vector<string> archives;
+        int threads = max(1, (int)thread::hardware_concurrency());
+        int plies = EXPLORER_MAX_PLIES, memory_mb = EXPLORER_MEMORY_MB;
+        for (int i = 3; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc) { threads = atoi(argv[++i]); }
+            else if (arg == "--plies" && i + 1 < argc) { plies = atoi(argv[++i]); }
+            else if (arg == "--memory" && i + 1 < argc) { memory_mb = atoi(argv[++i]); }
+            else { archives.push_back(arg); }
+        }
+        if (!archives.empty()) { return build(argv[2], archives, threads, plies, memory_mb); }
+    }
+    if (command == "show") { return show(argv[2], argc > 3 ? argv[3] : ""); }
+    if (command == "bench" && argc > 3) { return bench(argv[2], argv[3]); }
+    cout << "Usage: chess-explorer build INDEX ARCHIVE... [--threads N] [--plies N] [--memory MB]\n"
+         << "       chess-explorer show INDEX [FEN] | bench INDEX ARCHIVE\n";
+    return 1;
+}
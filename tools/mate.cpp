@@ -0,0 +1,124 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mate.cpp>
+
+using namespace std;
+
+// Solves mate problems with the proof number search in src/mate.cpp.
+//
+//   chess-mate FILE... [--moves N] [--shortest] [--nodes N] [--time MS] [--hash MB]
+//   chess-mate --fen FEN [--moves N] ...
+//
+// FILE holds one position per line in EPD format, the "dm" operation gives the moves of the direct mate, e.g.
+//   2q1nk1r/4Rp2/1ppp1P2/6Pp/3p1B2/3P3P/PPP1Q3/6K1 w - - dm 5; id "Problem 1";
+// Without it the position is searched for a mate in --moves. The answer is "mate in N", "no mate in N", or
+// unknown when a limit is reached first.
+
+#define MATE_DEFAULT_MOVES 5
+
+typedef struct {
+    string id;
+    string fen;
+    int moves; // 0 if the file doesn't give them
+} MateProblem;
+
+// Reads the positions and their "dm" and "id" operations
+static bool load_problems(string path, vector<MateProblem>& problems) {
+    ifstream in(path);
+    if (!in) {
+        cout << "Cannot read: " << path << endl;
+        return false;
+    }
+    string line;
+    int number = 0;
+    while (getline(in, line)) {
+        number++;
+        istringstream fields(line);
+        string parts[4];
+        if (!(fields >> parts[0] >> parts[1] >> parts[2] >> parts[3])) { continue; }
+        MateProblem problem = { path + ":" + to_string(number), parts[0] + " " + parts[1] + " " + parts[2] + " " + parts[3], 0 };
+        string rest;
+        getline(fields, rest);
+        istringstream operations(rest);
+        string operation;
+        while (getline(operations, operation, ';')) {
+            istringstream words(operation);
+            string opcode, operand;
+            words >> opcode;
+            getline(words >> ws, operand);
+            if (opcode == "dm") { problem.moves = atoi(operand.c_str()); }
+            else if (opcode == "id") { problem.id = operand.substr(operand.find('"') + 1, operand.rfind('"') - operand.find('"') - 1); }
+        }
+        problems.push_back(problem);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    vector<MateProblem> problems;
+    vector<string> files;
+    int moves = 0, time_ms = 0, hash_mb = MATE_HASH_MB;
+    uint64_t nodes = 0;
+    bool shortest = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--fen" && i + 1 < argc) { problems.push_back({ "fen", argv[++i], 0 }); }
+        else if (arg == "--moves" && i + 1 < argc) { moves = atoi(argv[++i]); }
+        else if (arg == "--shortest") { shortest = true; }
+        else if (arg == "--nodes" && i + 1 < argc) { nodes = atoll(argv[++i]); }
+        else if (arg == "--time" && i + 1 < argc) { time_ms = atoi(argv[++i]); }
+        else if (arg == "--hash" && i + 1 < argc) { hash_mb = atoi(argv[++i]); }
+        else if (arg[0] != '-') { files.push_back(arg); }
+        else {
+            problems.clear();
+            files.clear();
+            break;
+        }
+    }
+    for (auto& file : files) {
+        if (!load_problems(file, problems)) { return 1; }
+    }
+    if (problems.empty()) {
+        cout << "Usage: chess-mate FILE... | --fen FEN [--moves N] [--shortest] [--nodes N] [--time MS] [--hash MB]\n";
+        return 1;
+    }
+
+    MateSolver solver(hash_mb);
+    int solved = 0;
+    uint64_t total_nodes = 0;
+    int64_t total_ms = 0;
+    for (auto& problem : problems) {
+        Position position;
+        if (!position.load_fen(problem.fen)) {
+            cout << problem.id << ": invalid position\n";
+            continue;
+        }
+        int asked = moves ? moves : problem.moves ? problem.moves : MATE_DEFAULT_MOVES;
+        solver.getTable().clear();
+        int collections = solver.getTable().getCollections();
+        MateAnswer answer = solver.solve(position, asked, shortest, nodes, time_ms);
+        total_nodes += answer.nodes;
+        total_ms += answer.time_ms;
+        cout << problem.id << ": ";
+        if (answer.result == MATE_FOUND) {
+            cout << "mate in " << answer.moves << ",";
+            for (PackedMove move : answer.line) {
+                cout << " " << position.san(move);
+                Undo undo;
+                position.do_move(move, undo);
+            }
+        }
+        else if (answer.result == MATE_NONE) { cout << "no mate in " << answer.moves; }
+        else { cout << "unknown, stopped at mate in " << answer.moves; }
+        cout << " (" << answer.nodes << " nodes, " << answer.time_ms << " ms, " << solver.getTable().getCollections() - collections
+             << " collections)\n";
+        // A problem with a given mate is solved when the mate is found, any other one when it is answered
+        if (problem.moves ? answer.result == MATE_FOUND : answer.result != MATE_UNKNOWN) { solved++; }
+    }
+    cout << "Solved " << solved << " of " << problems.size() << ", " << total_nodes << " nodes in " << total_ms << " ms\n";
+    return solved == (int)problems.size() ? 0 : 2;
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include <pack.cpp>
+
+using namespace std;
+
+// Command line tool for asset packs, run by the build:
+//   chess-pack build ROOT OUTPUT      packs ROOT/icon.png and everything in ROOT/assets
+//   chess-pack embed PACK SOURCE      writes the pack as a C array, to compile it into the executable
+//   chess-pack list PACK              prints the files of a pack
+
+static int build(string root, string output) {
+    vector<string> names;
+    if (filesystem::exists(root + "/icon.png")) { names.push_back("icon.png"); }
+    error_code error;
+    for (auto& entry : filesystem::recursive_directory_iterator(root + "/assets", error)) {
+        if (!entry.is_regular_file()) { continue; }
+        names.push_back(filesystem::relative(entry.path(), root).generic_string());
+    }
+    if (error) {
+        cout << "Cannot find: " << root + "/assets" << endl;
+        return 1;
+    }
+    if (!write_pack(root, names, output)) { return 1; }
+    cout << "Packed " << names.size() << " files into " << output << ", " << filesystem::file_size(output) << " bytes\n";
+    return 0;
+}
+
+static int embed(string path, string source) {
+    ifstream in(path, ios::binary);
+    vector<unsigned char> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    AssetPack pack;
+    if (data.empty() || !pack.open_memory(data.data(), data.size())) {
+        cout << "Not an asset pack: " << path << endl;
+        return 1;
+    }
+    ofstream out(source, ios::trunc);
+    out << "// Written by chess-pack embed from " << filesystem::path(path).filename().string() << ", do not edit\n";
+    out << "#include <cstddef>\n\n";
+    out << "extern \"C\" const size_t chess_asset_pack_size = " << data.size() << ";\n";
+    // Aligned like a mapped file, so the entries can be read in place
+    out << "extern \"C\" alignas(16) const unsigned char chess_asset_pack[] = {\n";
+    for (size_t i = 0; i < data.size(); i++) {
+        out << (int)data[i] << (i + 1 < data.size() ? "," : "") << (i % 32 == 31 ? "\n" : "");
+    }
+    out << "\n};\n";
+    if (!out) {
+        cout << "Cannot write: " << source << endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int list(string path) {
+    AssetPack pack;
+    if (!pack.open(path)) {
+        cout << "Not an asset pack: " << path << endl;
+        return 1;
+    }
+    for (uint32_t i = 0; i < pack.getCount(); i++) {
+        const PackEntry& entry = pack.getEntry(i);
+        cout << entry.size << "\t" << entry.name << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    string command = argc > 2 ? argv[1] : "";
+    if (command == "build" && argc > 3) { return build(argv[2], argv[3]); }
+    if (command == "embed" && argc > 3) { return embed(argv[2], argv[3]); }
+    if (command == "list") { return list(argv[2]); }
+    cout << "Usage: chess-pack build ROOT OUTPUT | embed PACK SOURCE | list PACK\n";
+    return 1;
+}
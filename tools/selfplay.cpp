@@ -0,0 +1,130 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+
+#include <search.cpp>
+#include <training.cpp>
+
+using namespace std;
+
+// Generates training data by playing randomized games against itself on every core.
+//
+//   chess-selfplay OUTPUT [--positions N] [--threads N] [--nodes N] [--random-plies N] [--compress]
+//
+// Every game starts with a few random moves, then both sides play the best move of a small search.
+// The quiet positions of a game (not in check, best move not a capture) are packed with the search
+// score and, once the game is over, its result.
+
+#define SELFPLAY_MAX_PLIES 300 // Games still running after this are counted as draws
+#define SELFPLAY_HASH_MB 4
+
+typedef struct {
+    uint64_t positions;
+    int threads;
+    int nodes;
+    int random_plies;
+} SelfPlayOptions;
+
+atomic<uint64_t> taken_positions(0); // Reserved by the threads for the records of their games, up to the budget
+atomic<uint64_t> played_games(0);
+
+static void play_games(SelfPlayOptions options, TrainingWriter& writer, uint64_t seed) {
+    mt19937_64 rng(seed);
+    TranspositionTable tt(SELFPLAY_HASH_MB);
+    Search search(tt);
+    vector<PackedPosition> chunk;
+    chunk.reserve(TRAINING_CHUNK_RECORDS);
+    vector<PackedPosition> game_records;
+    PackedMove list[MAX_MOVES];
+    SearchLimits limits = { 0, 1, (uint64_t)options.nodes, 0, false };
+
+    while (taken_positions < options.positions) {
+        Position position;
+        game_records.clear();
+        State state = NEUTRAL;
+        int ply = 0;
+        for (; ply < SELFPLAY_MAX_PLIES; ply++) {
+            state = position.state();
+            if (state != NEUTRAL && state != WHITE_CHECK && state != BLACK_CHECK) { break; }
+            PackedMove move;
+            if (ply < options.random_plies) {
+                int count = position.generate_moves(list);
+                move = list[rng() % count];
+            }
+            else {
+                vector<SearchLine> lines = search.run(position, limits);
+                move = lines[0].pv[0];
+                bool quiet = position.squares[move_to(move)] == 0 && !position.is_en_passant(move) &&
+                    move_promotion(move) == NO_PIECE_TYPE && !position.in_check();
+                if (quiet && abs(lines[0].score) < MATE_BOUND) {
+                    int score = position.turn == WHITE ? lines[0].score : -lines[0].score;
+                    PackedPosition packed;
+                    if (pack_position(position, UNKNOWN_RESULT, score, packed)) { game_records.push_back(packed); }
+                }
+            }
+            Undo undo;
+            position.do_move(move, undo);
+        }
+        GameResult result = ply == SELFPLAY_MAX_PLIES ? DRAW : result_from_state(state);
+        uint64_t first = taken_positions.fetch_add(game_records.size());
+        if (first >= options.positions) { break; } // Another thread filled the budget while this game was played
+        size_t take = min<uint64_t>(game_records.size(), options.positions - first); // The last game may be cut short
+        for (size_t i = 0; i < take; i++) {
+            game_records[i].result = result;
+            chunk.push_back(game_records[i]);
+            if (chunk.size() == TRAINING_CHUNK_RECORDS) {
+                writer.write(chunk.data(), chunk.size());
+                chunk.clear();
+            }
+        }
+        played_games++;
+    }
+    writer.write(chunk.data(), chunk.size());
+}
+
+int main(int argc, char* argv[]) {
+    SelfPlayOptions options = { 1000000, (int)thread::hardware_concurrency(), 1000, 8 };
+    string output;
+    bool compress = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--positions" && i + 1 < argc) { options.positions = atoll(argv[++i]); }
+        else if (arg == "--threads" && i + 1 < argc) { options.threads = atoi(argv[++i]); }
+        else if (arg == "--nodes" && i + 1 < argc) { options.nodes = atoi(argv[++i]); }
+        else if (arg == "--random-plies" && i + 1 < argc) { options.random_plies = atoi(argv[++i]); }
+        else if (arg == "--compress") { compress = true; }
+        else if (output.empty() && arg[0] != '-') { output = arg; }
+        else { output.clear(); break; }
+    }
+    if (output.empty()) {
+        cout << "Usage: chess-selfplay OUTPUT [--positions N] [--threads N] [--nodes N] [--random-plies N] [--compress]\n";
+        return 1;
+    }
+    options.threads = max(1, options.threads);
+
+    TrainingWriter writer;
+    if (!writer.open(output, compress)) { return 1; }
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    random_device device;
+    for (int i = 0; i < options.threads; i++) {
+        threads.emplace_back(play_games, options, ref(writer), ((uint64_t)device() << 32) | device());
+    }
+    while (taken_positions < options.positions) {
+        this_thread::sleep_for(chrono::seconds(1));
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        uint64_t positions = min<uint64_t>(taken_positions, options.positions);
+        cout << "\r" << played_games << " games, " << positions << " positions, "
+             << (uint64_t)(positions * 60 / seconds) << " positions/min" << flush;
+    }
+    for (auto& t : threads) { t.join(); }
+    writer.close();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "\r" << played_games << " games, " << writer.getRecords() << " positions in " << seconds << "s, "
+         << writer.getBytes() / max((uint64_t)1, writer.getRecords()) << " bytes per position on disk\n";
+    return 0;
+}
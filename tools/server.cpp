@@ -0,0 +1,546 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <position.cpp>
+#include <clock.cpp>
+#include <constants.h>
+
+using namespace std;
+
+// Headless server hosting many games at once, on a single epoll event loop.
+//
+// Clients send one command per line, and get one line back starting with "ok" or "error":
+//   new [control]      creates a game with a time control in seconds,   -> ok <id>
+//                      [moves/]base[+increment][d delay], e.g. 300+2
+//   move <id> <move>   plays a move in coordinate notation (e2e4, e7e8q) -> ok <state>
+//   moves <id>         lists the legal moves                           -> ok <move> <move> ...
+//   state <id>         state, side to move and clocks in milliseconds   -> ok <state> <turn> <white> <black>
+//   fen <id>           the position as FEN                             -> ok <fen>
+//   close <id>         frees the game                                  -> ok
+//   stats              games, memory per game and moves per second     -> ok games=...
+//   quit               closes the connection
+//
+// Any connection may send commands for any game, so two players just share the id. A game belongs to the
+// connection that created it though, and is freed when that connection closes, so clients that go away without
+// closing their games don't leave them behind.
+
+#define MAX_EVENTS 256
+#define MAX_LINE 4096
+#define REPORT_INTERVAL 5000 // ms between the statistics written to stdout
+#define BENCH_MAX_PLIES 400 // Random games are restarted after this many plies
+
+const char* STATE_NAMES[] = {
+    "NEUTRAL", "WHITE_CHECK", "BLACK_CHECK", "WHITE_CHECKMATE", "BLACK_CHECKMATE",
+    "WHITE_TIMES_UP", "BLACK_TIMES_UP", "TIE"
+};
+
+// Milliseconds from the monotonic clock, used for the statistics and the benchmark
+int64_t now_ms() {
+    return clock_now_us() / 1000;
+}
+
+// A single hosted game, the rules state plus the clocks of both players
+typedef struct {
+    Position position;
+    ChessClock clock; // White's time runs from the creation of the game
+    State state;
+    bool active;
+    int owner; // Connection that created the game
+    vector<PackedMove> moves;
+} Game;
+
+// A client connection with its unprocessed input and unsent output
+typedef struct {
+    int fd;
+    string input;
+    string output;
+    vector<int> games; // Games created by the connection, freed with it
+} Connection;
+
+class GameServer {
+    private:
+        int epoll_fd;
+        vector<int> listeners;
+        unordered_map<int, Connection> connections;
+        vector<Game> games;
+        vector<int> free_games;
+        int active_games = 0;
+        uint64_t total_moves = 0;
+        uint64_t report_moves = 0;
+        int64_t last_report = 0;
+
+        static bool set_nonblocking(int fd) {
+            int flags = fcntl(fd, F_GETFL, 0);
+            return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+        }
+
+        bool add_listener(int fd) {
+            if (listen(fd, SOMAXCONN) != 0 || !set_nonblocking(fd)) {
+                cout << "Error listening: " << strerror(errno) << endl;
+                close(fd);
+                return false;
+            }
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            listeners.push_back(fd);
+            return true;
+        }
+
+        void accept_connections(int listener) {
+            while (true) {
+                int fd = accept(listener, NULL, NULL);
+                if (fd == -1) { return; }
+                set_nonblocking(fd);
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                epoll_event event = {};
+                event.events = EPOLLIN | EPOLLRDHUP;
+                event.data.fd = fd;
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+                connections[fd] = { fd, "", "", {} };
+            }
+        }
+
+        void close_connection(int fd) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            close(fd);
+            vector<int> owned = move(connections[fd].games);
+            for (int index : owned) { free_game(games[index]); }
+            connections.erase(fd);
+        }
+
+        // Reads everything available and answers every complete line. A client that closed its side still gets
+        // the answers to the lines it sent before, then the connection is closed.
+        void read_connection(Connection& connection) {
+            char buffer[16384];
+            bool closed = false;
+            while (true) {
+                ssize_t n = read(connection.fd, buffer, sizeof(buffer));
+                if (n > 0) {
+                    connection.input.append(buffer, n);
+                    continue;
+                }
+                if (n == 0) { closed = true; }
+                else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    close_connection(connection.fd);
+                    return;
+                }
+                break;
+            }
+            size_t start = 0, end;
+            while ((end = connection.input.find('\n', start)) != string::npos) {
+                string line = connection.input.substr(start, end - start);
+                start = end + 1;
+                if (!line.empty() && line.back() == '\r') { line.pop_back(); }
+                if (line == "quit") {
+                    flush_connection(connection);
+                    close_connection(connection.fd);
+                    return;
+                }
+                connection.output += handle_command(connection, line) + "\n";
+            }
+            connection.input.erase(0, start);
+            if (connection.input.size() > MAX_LINE) {
+                close_connection(connection.fd);
+                return;
+            }
+            flush_connection(connection);
+            if (closed) { close_connection(connection.fd); }
+        }
+
+        // Writes as much output as the socket takes, and waits for EPOLLOUT if some is left
+        void flush_connection(Connection& connection) {
+            size_t sent = 0;
+            while (sent < connection.output.size()) {
+                ssize_t n = write(connection.fd, connection.output.data() + sent, connection.output.size() - sent);
+                if (n <= 0) { break; }
+                sent += n;
+            }
+            connection.output.erase(0, sent);
+            epoll_event event = {};
+            event.events = EPOLLIN | EPOLLRDHUP | (connection.output.empty() ? 0 : (uint32_t)EPOLLOUT);
+            event.data.fd = connection.fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+        }
+
+        // Finds an active game by the id given by the client
+        Game* find_game(const string& id) {
+            char* end;
+            long index = strtol(id.c_str(), &end, 10);
+            if (id.empty() || *end != '\0' || index < 0 || index >= (long)games.size() || !games[index].active) {
+                return NULL;
+            }
+            return &games[index];
+        }
+
+        // Flags the side to move if its time has run out, clocks are only checked when a game is used
+        void update_clock(Game& game) {
+            if (game.state > BLACK_CHECK) { return; }
+            if (game.clock.flag(clock_now_us())) {
+                game.state = game.clock.getRunningSide() == WHITE ? WHITE_TIMES_UP : BLACK_TIMES_UP;
+            }
+        }
+
+        // Time left in milliseconds
+        int64_t time_left(Game& game, Color color) {
+            return game.clock.time_left(color, clock_now_us()) / 1000;
+        }
+
+        string new_game(Connection& connection, TimeControl control) {
+            int index;
+            if (free_games.empty()) {
+                index = games.size();
+                games.push_back({});
+            }
+            else {
+                index = free_games.back();
+                free_games.pop_back();
+            }
+            Game& game = games[index];
+            game.position.reset();
+            game.clock.reset(control);
+            game.clock.start(game.position.turn, clock_now_us()); // Every move is then a press, the first one too
+            game.state = NEUTRAL;
+            game.active = true;
+            game.owner = connection.fd;
+            game.moves.clear();
+            connection.games.push_back(index);
+            active_games++;
+            return "ok " + to_string(index);
+        }
+
+        // Frees a game and its move history, and takes it from the games of its connection
+        void free_game(Game& game) {
+            int index = &game - &games[0];
+            vector<int>& owned = connections[game.owner].games;
+            owned.erase(remove(owned.begin(), owned.end(), index), owned.end());
+            game.active = false;
+            game.moves = vector<PackedMove>();
+            game.position.history = vector<uint64_t>();
+            free_games.push_back(index);
+            active_games--;
+        }
+
+        string play_move(Game& game, const string& name) {
+            update_clock(game);
+            if (game.state > BLACK_CHECK) { return "error game over"; }
+            PackedMove move = game.position.parse_move(name);
+            if (move == NULL_MOVE) { return "error illegal move"; }
+
+            int64_t now = clock_now_us();
+            if (!game.clock.press(now)) {
+                game.state = game.clock.getRunningSide() == WHITE ? WHITE_TIMES_UP : BLACK_TIMES_UP;
+                return "error game over";
+            }
+
+            Undo undo;
+            game.position.do_move(move, undo);
+            game.moves.push_back(move);
+            game.state = game.position.state();
+            total_moves++;
+            report_moves++;
+            return (string)"ok " + STATE_NAMES[game.state];
+        }
+
+        // Memory used by a game, including its move history
+        size_t game_memory(Game& game) {
+            return sizeof(Game) + game.moves.capacity() * sizeof(PackedMove) +
+                game.position.history.capacity() * sizeof(uint64_t);
+        }
+
+        string stats() {
+            size_t memory = 0;
+            for (auto& game : games) {
+                if (game.active) { memory += game_memory(game); }
+            }
+            int64_t elapsed = max((int64_t)1, now_ms() - last_report);
+            char line[256];
+            snprintf(line, sizeof(line),
+                "ok games=%d connections=%zu bytes_per_game=%zu total_moves=%llu moves_per_second=%.0f",
+                active_games, connections.size(), active_games == 0 ? 0 : memory / active_games,
+                (unsigned long long)total_moves, report_moves * 1000.0 / elapsed);
+            return line;
+        }
+
+        string handle_command(Connection& connection, const string& line) {
+            istringstream stream(line);
+            string command, id, argument;
+            stream >> command >> id >> argument;
+
+            if (command == "new") {
+                TimeControl control = { (int64_t)TIME * 1000, 0, 0, 0 };
+                if (!id.empty() && !parse_time_control(id, control)) { return "error invalid time"; }
+                return new_game(connection, control);
+            }
+            if (command == "stats") { return stats(); }
+
+            Game* game = find_game(id);
+            if (command == "move" || command == "moves" || command == "state" || command == "fen" || command == "close") {
+                if (game == NULL) { return "error unknown game"; }
+            }
+            else { return "error unknown command"; }
+
+            if (command == "move") { return play_move(*game, argument); }
+            if (command == "moves") {
+                string result = "ok";
+                update_clock(*game);
+                if (game->state > BLACK_CHECK) { return result; }
+                PackedMove list[MAX_MOVES];
+                int count = game->position.generate_moves(list);
+                for (int i = 0; i < count; i++) { result += " " + move_name(list[i]); }
+                return result;
+            }
+            if (command == "state") {
+                update_clock(*game);
+                return (string)"ok " + STATE_NAMES[game->state] + (game->position.turn == WHITE ? " w " : " b ") +
+                    to_string(time_left(*game, WHITE)) + " " + to_string(time_left(*game, BLACK));
+            }
+            if (command == "fen") { return "ok " + game->position.fen(); }
+
+            // close
+            free_game(*game);
+            return "ok";
+        }
+
+        void report() {
+            int64_t now = now_ms();
+            if (now - last_report < REPORT_INTERVAL) { return; }
+            if (report_moves > 0) { cout << stats().substr(3) << endl; }
+            report_moves = 0;
+            last_report = now;
+        }
+
+    public:
+        GameServer() {
+            epoll_fd = epoll_create1(0);
+        }
+
+        bool listen_tcp(int port) {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+                cout << "Cannot bind to port " << port << ": " << strerror(errno) << endl;
+                close(fd);
+                return false;
+            }
+            return add_listener(fd);
+        }
+
+        bool listen_unix(string path) {
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un address = {};
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+            unlink(path.c_str());
+            if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+                cout << "Cannot bind to " << path << ": " << strerror(errno) << endl;
+                close(fd);
+                return false;
+            }
+            return add_listener(fd);
+        }
+
+        void run() {
+            epoll_event events[MAX_EVENTS];
+            last_report = now_ms();
+            while (true) {
+                int n = epoll_wait(epoll_fd, events, MAX_EVENTS, REPORT_INTERVAL);
+                for (int i = 0; i < n; i++) {
+                    int fd = events[i].data.fd;
+                    if (find(listeners.begin(), listeners.end(), fd) != listeners.end()) {
+                        accept_connections(fd);
+                        continue;
+                    }
+                    auto it = connections.find(fd);
+                    if (it == connections.end()) { continue; }
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+                        read_connection(it->second);
+                    }
+                    else if (events[i].events & EPOLLOUT) {
+                        flush_connection(it->second);
+                    }
+                }
+                report();
+            }
+        }
+};
+
+// Load generator for testing on loopback: keeps the given number of games running with random moves
+// on a single epoll loop, and reports the moves per second seen by the clients
+class BenchClient {
+    private:
+        typedef struct {
+            int fd;
+            string id;
+            string input;
+            string pending; // The command the client is waiting for an answer to
+            int plies;
+        } Player;
+
+        int epoll_fd;
+        vector<Player> players;
+        mt19937 random;
+        uint64_t moves = 0;
+
+        static int connect_to(string unix_path, int port) {
+            int fd;
+            if (!unix_path.empty()) {
+                fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                sockaddr_un address = {};
+                address.sun_family = AF_UNIX;
+                strncpy(address.sun_path, unix_path.c_str(), sizeof(address.sun_path) - 1);
+                if (connect(fd, (sockaddr*)&address, sizeof(address)) != 0) { close(fd); return -1; }
+            }
+            else {
+                fd = socket(AF_INET, SOCK_STREAM, 0);
+                sockaddr_in address = {};
+                address.sin_family = AF_INET;
+                address.sin_port = htons(port);
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                if (connect(fd, (sockaddr*)&address, sizeof(address)) != 0) { close(fd); return -1; }
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+            return fd;
+        }
+
+        void send(Player& player, string command) {
+            player.pending = command.substr(0, command.find(' '));
+            command += "\n";
+            if (write(player.fd, command.data(), command.size()) != (ssize_t)command.size()) {
+                cout << "Error writing to server\n";
+                exit(1);
+            }
+        }
+
+        // Answers one response line from the server with the next command
+        void respond(Player& player, const string& line) {
+            istringstream stream(line);
+            string status;
+            stream >> status;
+            if (player.pending == "new") {
+                stream >> player.id;
+                player.plies = 0;
+                send(player, "moves " + player.id);
+            }
+            else if (player.pending == "moves") {
+                vector<string> legal;
+                string move;
+                while (stream >> move) { legal.push_back(move); }
+                if (legal.empty() || player.plies >= BENCH_MAX_PLIES) {
+                    send(player, "close " + player.id);
+                }
+                else {
+                    send(player, "move " + player.id + " " + legal[random() % legal.size()]);
+                }
+            }
+            else if (player.pending == "move") {
+                moves++;
+                player.plies++;
+                send(player, "moves " + player.id);
+            }
+            else if (player.pending == "close") {
+                send(player, "new");
+            }
+        }
+
+    public:
+        bool run(int count, int seconds, string unix_path, int port) {
+            epoll_fd = epoll_create1(0);
+            players.resize(count);
+            for (int i = 0; i < count; i++) {
+                players[i].fd = connect_to(unix_path, port);
+                if (players[i].fd == -1) {
+                    cout << "Cannot connect to the server: " << strerror(errno) << endl;
+                    return false;
+                }
+                epoll_event event = {};
+                event.events = EPOLLIN;
+                event.data.u32 = i;
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, players[i].fd, &event);
+                send(players[i], "new");
+            }
+
+            epoll_event events[MAX_EVENTS];
+            int64_t start = now_ms();
+            while (now_ms() - start < seconds * 1000) {
+                int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+                for (int i = 0; i < n; i++) {
+                    Player& player = players[events[i].data.u32];
+                    char buffer[16384];
+                    ssize_t length = read(player.fd, buffer, sizeof(buffer));
+                    if (length <= 0) {
+                        cout << "Server closed the connection\n";
+                        return false;
+                    }
+                    player.input.append(buffer, length);
+                    size_t end;
+                    while ((end = player.input.find('\n')) != string::npos) {
+                        string line = player.input.substr(0, end);
+                        player.input.erase(0, end + 1);
+                        respond(player, line);
+                    }
+                }
+            }
+            double elapsed = (now_ms() - start) / 1000.0;
+            cout << count << " games, " << moves << " moves in " << elapsed << "s, "
+                << (uint64_t)(moves / elapsed) << " moves/s\n";
+            for (auto& player : players) { close(player.fd); }
+            return true;
+        }
+};
+
+int main(int argc, char* argv[]) {
+    int port = 7777;
+    string unix_path;
+    int bench_games = 0;
+    int bench_seconds = 10;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) { port = atoi(argv[++i]); }
+        else if (arg == "--unix" && i + 1 < argc) { unix_path = argv[++i]; }
+        else if (arg == "--bench" && i + 1 < argc) { bench_games = atoi(argv[++i]); }
+        else if (arg == "--seconds" && i + 1 < argc) { bench_seconds = atoi(argv[++i]); }
+        else {
+            cout << "Usage: chess-server [--port N | --unix PATH] [--bench GAMES [--seconds S]]\n";
+            return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    if (bench_games > 0) {
+        BenchClient client;
+        return client.run(bench_games, bench_seconds, unix_path, port) ? 0 : 1;
+    }
+
+    GameServer server;
+    if (!unix_path.empty() ? !server.listen_unix(unix_path) : !server.listen_tcp(port)) { return 1; }
+    cout << "Listening on " << (!unix_path.empty() ? unix_path : "127.0.0.1:" + to_string(port)) << endl;
+    server.run();
+    return 0;
+}
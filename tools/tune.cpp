@@ -0,0 +1,255 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cmath>
+
+#include <eval.cpp>
+#include <training.cpp>
+
+using namespace std;
+
+// Tunes the evaluation parameters to game results (Texel's method).
+//
+//   chess-tune DATA... [--epochs N] [--threads N] [--rate R] [--lambda L] [--output FILE]
+//
+// The evaluation is linear in its parameters, so every position is reduced to the table entries of its
+// pieces and its phase. The loss is the logistic (cross entropy) loss between the game result and the
+// evaluation mapped to a win probability, minimized with Adam over the whole data set. Gradients are
+// summed by every thread over its share of the positions, and then added up.
+
+#define TUNE_TABLE (EVAL_TYPES * 64) // Combined value and piece-square entries per phase
+
+// A position reduced to what the evaluation looks at. Pieces are stored as type * 64 + table index,
+// padded with type 0 whose entries are always 0. So every position has the same number of entries,
+// and the sums below are fixed length loops the compiler can vectorize.
+typedef struct {
+    uint16_t white[16];
+    uint16_t black[16];
+    float phase; // Weight of the middlegame, the endgame gets the rest
+    float target; // Expected result from white's view, 1 is a win
+} TuneEntry;
+
+typedef struct {
+    double loss;
+    vector<double> gradient; // Per phase, per combined table entry
+} TunePart;
+
+static double sigmoid(double x) { return 1.0 / (1.0 + exp(-x)); }
+
+class Tuner {
+    private:
+        vector<TuneEntry> entries;
+        vector<double> params;
+        double scale; // Converts centipawns to the logistic input, fitted before tuning
+        int threads;
+
+        // Value plus piece-square entry for every type and index, the table the entries point into
+        void build_tables(float* tables) {
+            for (int phase = MG; phase <= EG; phase++) {
+                for (int type = 0; type < EVAL_TYPES; type++) {
+                    for (int i = 0; i < 64; i++) {
+                        tables[phase * TUNE_TABLE + type * 64 + i] =
+                            params[value_param(phase, type)] + params[square_param(phase, type, i)];
+                    }
+                }
+            }
+        }
+
+        static float evaluate_entry(const TuneEntry& entry, const float* mg, const float* eg) {
+            float sum_mg = 0, sum_eg = 0;
+            for (int i = 0; i < 16; i++) {
+                sum_mg += mg[entry.white[i]] - mg[entry.black[i]];
+                sum_eg += eg[entry.white[i]] - eg[entry.black[i]];
+            }
+            return entry.phase * sum_mg + (1 - entry.phase) * sum_eg;
+        }
+
+        // Loss and gradient of a range of entries
+        void compute_part(size_t begin, size_t end, const float* tables, bool with_gradient, TunePart& part) {
+            const float* mg = tables;
+            const float* eg = tables + TUNE_TABLE;
+            part.loss = 0;
+            if (with_gradient) { part.gradient.assign(2 * TUNE_TABLE, 0.0); }
+            double* gradient = part.gradient.data();
+            for (size_t e = begin; e < end; e++) {
+                const TuneEntry& entry = entries[e];
+                double p = sigmoid(scale * evaluate_entry(entry, mg, eg));
+                p = min(max(p, 1e-9), 1 - 1e-9);
+                part.loss -= entry.target * log(p) + (1 - entry.target) * log(1 - p);
+                if (!with_gradient) { continue; }
+                double g = scale * (p - entry.target);
+                double g_mg = g * entry.phase, g_eg = g * (1 - entry.phase);
+                for (int i = 0; i < 16; i++) {
+                    gradient[entry.white[i]] += g_mg;
+                    gradient[entry.black[i]] -= g_mg;
+                    gradient[TUNE_TABLE + entry.white[i]] += g_eg;
+                    gradient[TUNE_TABLE + entry.black[i]] -= g_eg;
+                }
+            }
+        }
+
+        // Average loss over all entries, and the gradient of every parameter if asked for
+        double compute(vector<double>* gradient) {
+            vector<float> tables(2 * TUNE_TABLE);
+            build_tables(tables.data());
+            vector<TunePart> parts(threads);
+            vector<thread> workers;
+            size_t share = (entries.size() + threads - 1) / threads;
+            for (int t = 0; t < threads; t++) {
+                size_t begin = min(entries.size(), t * share), end = min(entries.size(), begin + share);
+                workers.emplace_back(&Tuner::compute_part, this, begin, end, tables.data(), gradient != NULL, ref(parts[t]));
+            }
+            for (auto& w : workers) { w.join(); }
+
+            double loss = 0;
+            for (auto& part : parts) { loss += part.loss; }
+            if (gradient != NULL) {
+                gradient->assign(EVAL_PARAMS, 0.0);
+                for (auto& part : parts) {
+                    for (int phase = MG; phase <= EG; phase++) {
+                        for (int type = 1; type < EVAL_TYPES; type++) {
+                            for (int i = 0; i < 64; i++) {
+                                double g = part.gradient[phase * TUNE_TABLE + type * 64 + i] / entries.size();
+                                (*gradient)[square_param(phase, type, i)] += g;
+                                if (type != KING) { (*gradient)[value_param(phase, type)] += g; } // Both sides have one king
+                            }
+                        }
+                    }
+                }
+            }
+            return loss / entries.size();
+        }
+
+    public:
+        Tuner(int threads) {
+            this->threads = max(1, threads);
+            params.assign(eval_params, eval_params + EVAL_PARAMS);
+            scale = log(10.0) / 400;
+        }
+
+        size_t size() { return entries.size(); }
+
+        // Adds the positions of a training file. The target blends the game result with the search score.
+        bool load(string path, double lambda) {
+            TrainingReader reader;
+            if (!reader.open(path)) { return false; }
+            vector<PackedPosition> records;
+            Position position;
+            while (reader.next_chunk(records)) {
+                for (auto& record : records) {
+                    if (record.result == UNKNOWN_RESULT) { continue; }
+                    unpack_position(record, position);
+                    TuneEntry entry;
+                    memset(&entry, 0, sizeof(entry));
+                    int count[2] = { 0, 0 };
+                    int phase = 0;
+                    for (int s = 0; s < 64; s++) {
+                        uint8_t piece = position.squares[s];
+                        if (piece == 0) { continue; }
+                        Color color = piece_color(piece);
+                        uint16_t index = piece_type(piece) * 64 + square_index(s, color);
+                        if (count[color] == 16) { continue; }
+                        (color == WHITE ? entry.white : entry.black)[count[color]++] = index;
+                        phase += piece_phase[piece_type(piece)];
+                    }
+                    entry.phase = min(phase, PHASE_MAX) / (float)PHASE_MAX;
+                    double result = record.result == WHITE_WINS ? 1.0 : record.result == BLACK_WINS ? 0.0 : 0.5;
+                    entry.target = lambda * result + (1 - lambda) * sigmoid(scale * record.score);
+                    entries.push_back(entry);
+                }
+            }
+            return true;
+        }
+
+        // Finds the scale from centipawns to win probability that fits the current parameters best
+        void fit_scale() {
+            double low = 0.1 * log(10.0) / 400, high = 4.0 * log(10.0) / 400;
+            for (int i = 0; i < 40; i++) {
+                double a = low + (high - low) / 3, b = high - (high - low) / 3;
+                scale = a;
+                double loss_a = compute(NULL);
+                scale = b;
+                double loss_b = compute(NULL);
+                if (loss_a < loss_b) { high = b; }
+                else { low = a; }
+            }
+            scale = (low + high) / 2;
+        }
+
+        double getScale() { return scale; }
+        double loss() { return compute(NULL); }
+
+        // Adam over the whole data set
+        void tune(int epochs, double rate) {
+            vector<double> gradient, m(EVAL_PARAMS, 0.0), v(EVAL_PARAMS, 0.0);
+            const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+            auto start = chrono::steady_clock::now();
+            for (int epoch = 1; epoch <= epochs; epoch++) {
+                double loss = compute(&gradient);
+                for (int i = 0; i < EVAL_PARAMS; i++) {
+                    m[i] = beta1 * m[i] + (1 - beta1) * gradient[i];
+                    v[i] = beta2 * v[i] + (1 - beta2) * gradient[i] * gradient[i];
+                    double m_hat = m[i] / (1 - pow(beta1, epoch)), v_hat = v[i] / (1 - pow(beta2, epoch));
+                    params[i] -= rate * m_hat / (sqrt(v_hat) + epsilon);
+                }
+                if (epoch % 25 == 0 || epoch == epochs) {
+                    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                    cout << "epoch " << epoch << " loss " << loss << " (" << seconds << "s)" << endl;
+                }
+            }
+        }
+
+        vector<int> getParams() {
+            vector<int> rounded(EVAL_PARAMS);
+            for (int i = 0; i < EVAL_PARAMS; i++) { rounded[i] = lround(params[i]); }
+            return rounded;
+        }
+};
+
+int main(int argc, char* argv[]) {
+    vector<string> inputs;
+    int epochs = 500;
+    int threads = thread::hardware_concurrency();
+    double rate = 1.0;
+    double lambda = 1.0;
+    string output = "eval_params.h";
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--epochs" && i + 1 < argc) { epochs = atoi(argv[++i]); }
+        else if (arg == "--threads" && i + 1 < argc) { threads = atoi(argv[++i]); }
+        else if (arg == "--rate" && i + 1 < argc) { rate = atof(argv[++i]); }
+        else if (arg == "--lambda" && i + 1 < argc) { lambda = atof(argv[++i]); }
+        else if (arg == "--output" && i + 1 < argc) { output = argv[++i]; }
+        else if (arg[0] != '-') { inputs.push_back(arg); }
+        else { inputs.clear(); break; }
+    }
+    if (inputs.empty()) {
+        cout << "Usage: chess-tune DATA... [--epochs N] [--threads N] [--rate R] [--lambda L] [--output FILE]\n";
+        return 1;
+    }
+
+    Tuner tuner(threads);
+    for (auto& path : inputs) {
+        if (!tuner.load(path, lambda)) { return 1; }
+    }
+    if (tuner.size() == 0) {
+        cout << "No positions with a result\n";
+        return 1;
+    }
+    tuner.fit_scale();
+    cout << tuner.size() << " positions, scale " << tuner.getScale() * 400 / log(10.0)
+         << ", loss " << tuner.loss() << endl;
+    tuner.tune(epochs, rate);
+
+    ofstream file(output);
+    if (!file) {
+        cout << "Cannot write: " << output << endl;
+        return 1;
+    }
+    write_eval_params(file, tuner.getParams().data());
+    cout << "Parameters written to " << output << ", copy it to src/eval_params.h to use them\n";
+    return 0;
+}